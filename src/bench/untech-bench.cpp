@@ -0,0 +1,586 @@
+#include "../models/sprite-importer.h"
+#include "../models/metasprite.h"
+#include "../models/metasprite/binaryformat.h"
+#include "../models/utsi2utms/utsi2utms.h"
+#include "../models/common/base64.h"
+#include "../models/common/file.h"
+#include "../models/common/image.h"
+#include "../models/common/imagescaler.h"
+#include "../models/common/string.h"
+#include "../models/common/xml/xmlreader.h"
+#include "../models/snes/bitplanes.h"
+#include "../models/snes/tileset.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// ::TODO windows equivalent::
+#include <unistd.h>
+
+using namespace UnTech;
+
+namespace SI = UnTech::SpriteImporter;
+namespace MS = UnTech::MetaSprite;
+
+void usage(const char* argv0)
+{
+    auto s = File::splitFilename(argv0);
+
+    std::cerr << "usage: " << s.second << " [-f <filter>] [-n <frames>] [-t <seconds>] [-j <threads>]\n"
+              << "\n"
+              << "Times the model layer's hot paths and prints one tab separated line per benchmark:\n"
+              << "    <name> <ops> <ns/op> <MB/s>\n"
+              << "\n"
+              << "  -f <filter>   only run the benchmarks whose name contains filter\n"
+              << "  -n <frames>   the number of frames in the synthetic frameset (default 100)\n"
+              << "  -t <seconds>  the minimum time spent on each benchmark (default 0.5)\n"
+              << "  -j <threads>  the number of threads used by Utsi2Utms::convert (default 1)\n"
+              << "\n"
+              << "For meaningful results build with optimizations, ie: `CXXFLAGS=-O2 make bench`\n";
+}
+
+/*
+ * BENCHMARK RUNNER
+ * ================
+ */
+
+class BenchmarkRunner {
+public:
+    BenchmarkRunner(const std::string& filter, double minTime)
+        : _filter(filter)
+        , _minTime(minTime)
+    {
+    }
+
+    void printHeader() const
+    {
+        std::cout << "# bitplanes: " << Snes::Bitplanes::implementationName() << '\n'
+                  << "# base64: " << Base64::implementationName() << '\n'
+                  << "benchmark\tops\tns_per_op\tmb_per_s\n";
+    }
+
+    /**
+     * Calls func until at least `minTime` seconds has elapsed.
+     *
+     * Each call to func processes `opsPerCall` operations and
+     * `bytesPerCall` bytes.
+     */
+    template <class Func>
+    void run(const std::string& name, size_t opsPerCall, size_t bytesPerCall, const Func& func)
+    {
+        if (!_filter.empty() && name.find(_filter) == std::string::npos) {
+            return;
+        }
+
+        // warm up
+        func();
+
+        unsigned long long nCalls = 1;
+        double elapsed;
+
+        while (true) {
+            auto start = std::chrono::steady_clock::now();
+
+            for (unsigned long long i = 0; i < nCalls; i++) {
+                func();
+            }
+
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (elapsed >= _minTime) {
+                break;
+            }
+            nCalls *= 2;
+        }
+
+        const double nOps = double(nCalls) * opsPerCall;
+        const double nsPerOp = elapsed * 1e9 / nOps;
+        const double mbPerSecond = double(nCalls) * bytesPerCall / elapsed / 1e6;
+
+        char line[64];
+        snprintf(line, sizeof(line), "%.1f\t%.2f", nsPerOp, mbPerSecond);
+
+        std::cout << name << '\t' << (unsigned long long)nOps << '\t' << line << std::endl;
+    }
+
+private:
+    const std::string _filter;
+    const double _minTime;
+};
+
+// Prevents the compiler from optimizing away the benchmarked code
+volatile size_t benchmarkSink = 0;
+
+/*
+ * SYNTHETIC FRAMESET
+ * ==================
+ */
+
+// A directory of temporary files that is deleted on destruction.
+class TempDirectory {
+public:
+    TempDirectory()
+    {
+        char dirTemplate[] = "/tmp/untech-bench-XXXXXX";
+
+        if (mkdtemp(dirTemplate) == nullptr) {
+            throw std::runtime_error("Cannot create temporary directory");
+        }
+        _path = dirTemplate;
+    }
+
+    TempDirectory(const TempDirectory&) = delete;
+
+    ~TempDirectory()
+    {
+        for (const std::string& f : _files) {
+            unlink(f.c_str());
+        }
+        rmdir(_path.c_str());
+    }
+
+    std::string file(const std::string& name)
+    {
+        std::string fn = File::joinPath(_path, name);
+        _files.push_back(fn);
+        return fn;
+    }
+
+private:
+    std::string _path;
+    std::vector<std::string> _files;
+};
+
+/*
+ * Creates a sprite importer frameset with `nFrames` 48x48 frames.
+ *
+ * Each frame contains 1-4 flipped tiles from a small pool of tiles (so the
+ * tileset is deduplicated) and some frames contain overlapping objects.
+ *
+ * Returns the size of the image in bytes.
+ */
+size_t writeSyntheticFrameSet(const std::string& utsiFilename, const std::string& imageFilename,
+                              unsigned nFrames)
+{
+    const unsigned FRAME_SIZE = 48;
+    const unsigned N_COLUMNS = 8;
+    const rgba TRANSPARENT(255, 0, 255, 255);
+
+    std::mt19937 rng(nFrames);
+    auto random = [&](unsigned max) {
+        return unsigned(std::uniform_int_distribution<unsigned>(0, max - 1)(rng));
+    };
+
+    std::vector<rgba> palette;
+    for (unsigned i = 0; i < 15; i++) {
+        palette.emplace_back(random(256), random(256), random(256), 255);
+    }
+
+    // A tile of transparent pixels is represented by an index of 0.
+    auto createTile = [&](unsigned size) {
+        std::vector<unsigned> tile(size * size);
+        unsigned nColors = 2 + random(14);
+
+        for (auto& p : tile) {
+            p = random(4) == 0 ? 0 : 1 + random(nColors);
+        }
+        return tile;
+    };
+
+    std::vector<std::vector<unsigned>> smallTiles, largeTiles;
+    for (unsigned i = 0; i < 6; i++) {
+        smallTiles.push_back(createTile(8));
+    }
+    for (unsigned i = 0; i < 4; i++) {
+        largeTiles.push_back(createTile(16));
+    }
+
+    const unsigned nRows = (nFrames + N_COLUMNS - 1) / N_COLUMNS;
+    Image image(N_COLUMNS * FRAME_SIZE, nRows * FRAME_SIZE);
+    image.fill(TRANSPARENT);
+
+    std::stringstream xml;
+    xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<!DOCTYPE untech>\n"
+        << "<spriteimporter id=\"bench\" image=\"" << File::splitFilename(imageFilename).second
+        << "\" transparent=\"ff00ff\">\n";
+
+    struct Obj {
+        unsigned x, y, size;
+    };
+
+    for (unsigned f = 0; f < nFrames; f++) {
+        const unsigned fx = (f % N_COLUMNS) * FRAME_SIZE;
+        const unsigned fy = (f / N_COLUMNS) * FRAME_SIZE;
+
+        xml << "  <frame id=\"f" << f << "\" order=\"2\">\n"
+            << "    <location x=\"" << fx << "\" y=\"" << fy
+            << "\" width=\"" << FRAME_SIZE << "\" height=\"" << FRAME_SIZE << "\" />\n"
+            << "    <origin x=\"24\" y=\"24\" />\n";
+
+        std::vector<Obj> objects;
+        const unsigned nObjects = 1 + random(4);
+
+        for (unsigned o = 0; o < nObjects; o++) {
+            const bool large = random(5) < 2;
+            const unsigned size = large ? 16 : 8;
+
+            Obj obj = { 0, 0, size };
+
+            if (o == 1 && random(5) < 2) {
+                // overlap the previous object
+                const Obj& prev = objects.back();
+                int x = int(prev.x) + int(random(9)) - 4;
+                int y = int(prev.y) + int(random(9)) - 4;
+
+                obj.x = std::min(std::max(x, 0), int(FRAME_SIZE - size));
+                obj.y = std::min(std::max(y, 0), int(FRAME_SIZE - size));
+            }
+            else {
+                bool found = false;
+                for (unsigned attempt = 0; attempt < 100 && !found; attempt++) {
+                    obj.x = random(FRAME_SIZE - size + 1);
+                    obj.y = random(FRAME_SIZE - size + 1);
+
+                    found = true;
+                    for (const Obj& p : objects) {
+                        if (obj.x < p.x + p.size && p.x < obj.x + size
+                            && obj.y < p.y + p.size && p.y < obj.y + size) {
+                            found = false;
+                        }
+                    }
+                }
+                if (!found) {
+                    continue;
+                }
+            }
+
+            const auto& tile = large ? largeTiles[random(largeTiles.size())]
+                                     : smallTiles[random(smallTiles.size())];
+            const bool hFlip = random(10) < 3;
+            const bool vFlip = random(10) < 3;
+
+            for (unsigned ty = 0; ty < size; ty++) {
+                rgba* imgBits = image.scanline(fy + obj.y + ty) + fx + obj.x;
+
+                for (unsigned tx = 0; tx < size; tx++) {
+                    unsigned sx = hFlip ? size - 1 - tx : tx;
+                    unsigned sy = vFlip ? size - 1 - ty : ty;
+                    unsigned p = tile[sy * size + sx];
+
+                    if (p != 0) {
+                        imgBits[tx] = palette[p - 1];
+                    }
+                }
+            }
+
+            xml << "    <object size=\"" << (large ? "large" : "small")
+                << "\" x=\"" << obj.x << "\" y=\"" << obj.y << "\" />\n";
+
+            objects.push_back(obj);
+        }
+
+        xml << "  </frame>\n";
+    }
+    xml << "</spriteimporter>\n";
+
+    if (!image.savePngImage(imageFilename)) {
+        throw std::runtime_error(image.errorString());
+    }
+
+    std::ofstream out(utsiFilename);
+    out << xml.str();
+    if (!out) {
+        throw std::runtime_error(utsiFilename + ": Cannot write file");
+    }
+
+    return image.size().width * image.size().height * sizeof(rgba);
+}
+
+/*
+ * BENCHMARKS
+ * ==========
+ */
+
+template <class TilesetT, size_t BIT_DEPTH>
+void benchmarkTileset(BenchmarkRunner& runner, const std::string& name)
+{
+    const unsigned N_TILES = 1024;
+
+    std::mt19937 rng(BIT_DEPTH);
+
+    TilesetT tileset;
+    for (unsigned i = 0; i < N_TILES; i++) {
+        tileset.addTile();
+        for (auto& p : tileset.tile(i)) {
+            p = rng() & TilesetT::PIXEL_MASK;
+        }
+    }
+
+    const std::vector<uint8_t> snesData = tileset.snesData();
+
+    runner.run("tileset/encode/" + name, N_TILES, snesData.size(), [&]() {
+        benchmarkSink += tileset.snesData().size();
+    });
+
+    runner.run("tileset/decode/" + name, N_TILES, snesData.size(), [&]() {
+        TilesetT t;
+        t.readSnesData(snesData);
+        benchmarkSink += t.size();
+    });
+
+    Snes::Palette<BIT_DEPTH> palette;
+    for (auto& c : palette.colors()) {
+        c.setData(rng());
+    }
+
+    const unsigned N_COLUMNS = 32;
+    const unsigned TS = TilesetT::TILE_SIZE;
+    Image image(N_COLUMNS * TS, N_TILES / N_COLUMNS * TS);
+
+    runner.run("tileset/draw/" + name, N_TILES, N_TILES * TilesetT::TILE_DATA_SIZE * sizeof(rgba), [&]() {
+        for (unsigned i = 0; i < N_TILES; i++) {
+            tileset.drawTile(image, palette, (i % N_COLUMNS) * TS, (i / N_COLUMNS) * TS,
+                             i, i & 1, i & 2);
+        }
+        benchmarkSink += image.data()->value;
+    });
+}
+
+void benchmarkImageScaler(BenchmarkRunner& runner)
+{
+    const unsigned IMAGE_SIZE = 1024;
+
+    std::mt19937 rng(IMAGE_SIZE);
+
+    Image image(IMAGE_SIZE, IMAGE_SIZE);
+    for (unsigned i = 0; i < IMAGE_SIZE * IMAGE_SIZE; i++) {
+        image.data()[i] = rng();
+    }
+
+    ImageScaler scaler;
+
+    // 3.44 is the 3x NTSC aspect ratio zoom
+    for (const double zoom : { 2.0, 3.0, 3.44, 6.0 }) {
+        const unsigned size = IMAGE_SIZE * zoom;
+        const std::string name = "image/scale/" + std::to_string(IMAGE_SIZE) + "x" + std::to_string(zoom).substr(0, 4);
+
+        runner.run(name, 1, size * size * sizeof(rgba), [&]() {
+            benchmarkSink += scaler.scale(image, size, size).data()->value;
+        });
+    }
+}
+
+void benchmarkBase64(BenchmarkRunner& runner)
+{
+    const size_t DATA_SIZE = 64 * 1024;
+
+    std::mt19937 rng(64);
+
+    std::vector<uint8_t> data(DATA_SIZE);
+    for (auto& d : data) {
+        d = rng();
+    }
+
+    std::stringstream encoded;
+    Base64::encode(data, encoded, 4);
+    const std::string text = encoded.str();
+
+    runner.run("base64/encode", 1, DATA_SIZE, [&]() {
+        std::stringstream out;
+        Base64::encode(data, out, 4);
+        benchmarkSink += out.tellp();
+    });
+
+    runner.run("base64/decode", 1, DATA_SIZE, [&]() {
+        benchmarkSink += Base64::decode(text).size();
+    });
+}
+
+// Visits every child tag of the current tag, decoding the base64 tilesets.
+void walkXml(Xml::XmlReader& xml)
+{
+    std::unique_ptr<Xml::XmlTag> tag;
+    while ((tag = xml.parseTag())) {
+        benchmarkSink += tag->attributes.size();
+
+        if (tag->name == "smalltileset" || tag->name == "largetileset") {
+            benchmarkSink += xml.parseBase64().size();
+        }
+        else {
+            walkXml(xml);
+        }
+        xml.parseCloseTag();
+    }
+}
+
+void benchmarkConversion(BenchmarkRunner& runner, TempDirectory& tmp,
+                         unsigned nFrames, unsigned nThreads)
+{
+    const std::string utsiFilename = tmp.file("bench.utsi");
+    const std::string imageFilename = tmp.file("bench.png");
+    const std::string utmsFilename = tmp.file("bench.utms");
+
+    const size_t imageSize = writeSyntheticFrameSet(utsiFilename, imageFilename, nFrames);
+    const std::string suffix = std::to_string(nFrames) + "frames";
+
+    SI::SpriteImporterDocument siDocument(utsiFilename);
+
+    // Loads the image
+    if (siDocument.frameSet().image().empty()) {
+        throw std::runtime_error(imageFilename + ": Cannot load image");
+    }
+
+    auto convert = [&]() {
+        Utsi2Utms converter;
+        converter.setThreadCount(nThreads);
+
+        auto msDocument = converter.convert(siDocument);
+
+        if (msDocument == nullptr || !converter.errors().empty()) {
+            for (const auto& e : converter.errors()) {
+                std::cerr << "error: " << e << '\n';
+            }
+            throw std::runtime_error("Cannot convert synthetic frameset");
+        }
+        return msDocument;
+    };
+
+    runner.run("utsi2utms/convert/" + suffix, 1, imageSize, [&]() {
+        benchmarkSink += convert()->frameSet().frames().size();
+    });
+
+    auto msDocument = convert();
+    const MS::FrameSet& msFrameSet = msDocument->frameSet();
+
+    std::string msXml;
+    {
+        std::stringstream out;
+        MS::Serializer::writeFile(msFrameSet, out);
+        msXml = out.str();
+
+        std::ofstream file(utmsFilename);
+        file << msXml;
+    }
+
+    runner.run("xml/parse/" + suffix, 1, msXml.size(), [&]() {
+        Xml::XmlReader xml(msXml);
+        auto tag = xml.parseTag();
+        walkXml(xml);
+    });
+
+    runner.run("metasprite/load/" + suffix, 1, msXml.size(), [&]() {
+        MS::MetaSpriteDocument doc(utmsFilename);
+        benchmarkSink += doc.frameSet().frames().size();
+    });
+
+    const std::string utmbFilename = tmp.file("bench.utmb");
+    MS::BinarySerializer::writeFile(msFrameSet, utmbFilename);
+    const size_t utmbSize = File::MemoryMappedFile(utmbFilename).size();
+
+    runner.run("metasprite/load-binary/" + suffix, 1, utmbSize, [&]() {
+        MS::MetaSpriteDocument doc(utmbFilename);
+        benchmarkSink += doc.frameSet().frames().size();
+    });
+
+    runner.run("metasprite/map-binary/" + suffix, 1, utmbSize, [&]() {
+        MS::Binary::BinaryFile file(utmbFilename);
+        benchmarkSink += file.nFrames();
+    });
+
+    // Frame::draw
+    {
+        const MS::Palette& palette = *msFrameSet.palettes().begin();
+
+        size_t nObjects = 0;
+        size_t nPixels = 0;
+        for (const auto fIt : msFrameSet.frames()) {
+            for (const MS::FrameObject& obj : fIt.second.objects()) {
+                nObjects++;
+                nPixels += obj.sizePx() * obj.sizePx();
+            }
+        }
+
+        Image image(256, 256);
+
+        runner.run("metasprite/draw/" + suffix, msFrameSet.frames().size(), nPixels * sizeof(rgba), [&]() {
+            for (const auto fIt : msFrameSet.frames()) {
+                fIt.second.draw(image, palette, 128, 128);
+            }
+            benchmarkSink += image.data()->value;
+        });
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string filter;
+    unsigned nFrames = 100;
+    unsigned nThreads = 1;
+    double minTime = 0.5;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (i + 1 >= argc || arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0') {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        const char* value = argv[++i];
+
+        if (arg[1] == 'f') {
+            filter = value;
+        }
+        else if (arg[1] == 'n' || arg[1] == 'j') {
+            auto v = String::toInt(value);
+            if (!v.second || v.first <= 0) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            (arg[1] == 'n' ? nFrames : nThreads) = v.first;
+        }
+        else if (arg[1] == 't') {
+            char* end;
+            minTime = strtod(value, &end);
+            if (*end != '\0' || minTime <= 0) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    try {
+        BenchmarkRunner runner(filter, minTime);
+        runner.printHeader();
+
+        benchmarkTileset<Snes::Tileset2bpp8px, 2>(runner, "2bpp-8px");
+        benchmarkTileset<Snes::Tileset4bpp8px, 4>(runner, "4bpp-8px");
+        benchmarkTileset<Snes::Tileset8bpp8px, 8>(runner, "8bpp-8px");
+        benchmarkTileset<Snes::Tileset4bpp16px, 4>(runner, "4bpp-16px");
+
+        benchmarkBase64(runner);
+
+        benchmarkImageScaler(runner);
+
+        TempDirectory tmp;
+        benchmarkConversion(runner, tmp, nFrames, nThreads);
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "error: " << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+#include "../models/metasprite.h"
+#include "../models/metasprite/binaryserializer.h"
+#include "../models/metasprite/tilesetorder.h"
+#include "../models/common/file.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace UnTech;
+
+namespace MS = UnTech::MetaSprite;
+
+void usage(const char* argv0)
+{
+    auto s = File::splitFilename(argv0);
+
+    std::cerr << "usage: " << s.second << " [-r] <input file> <output file>\n"
+              << "\n"
+              << "Converts a metasprite file between the XML (.utms) and binary (.utmb) formats.\n"
+              << "The format of each file is determined by its extension.\n"
+              << "\n"
+              << "  -r    reorder the tilesets to reduce the DMA transfers of each frame\n"
+              << "        and print the number of transfers before and after\n";
+}
+
+unsigned totalDmaTransfers(const MS::FrameSet& frameSet)
+{
+    unsigned nTransfers = 0;
+
+    for (const auto fIt : frameSet.frames()) {
+        nTransfers += MS::frameDmaUsage(fIt.second).nTransfers;
+    }
+    return nTransfers;
+}
+
+int main(int argc, char* argv[])
+{
+    bool reorderTiles = false;
+    int argi = 1;
+
+    if (argc == 4 && strcmp(argv[1], "-r") == 0) {
+        reorderTiles = true;
+        argi++;
+    }
+
+    if (argc - argi != 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const std::string inputFilename = argv[argi];
+    const std::string outputFilename = argv[argi + 1];
+
+    try {
+        MS::MetaSpriteDocument document(inputFilename);
+
+        if (reorderTiles) {
+            const unsigned before = totalDmaTransfers(document.frameSet());
+            MS::optimizeTilesetOrder(document.frameSet());
+            const unsigned after = totalDmaTransfers(document.frameSet());
+
+            std::cout << "DMA transfers: " << before << " -> " << after << '\n';
+        }
+
+        if (MS::BinarySerializer::isBinaryFilename(outputFilename)) {
+            MS::BinarySerializer::writeFile(document.frameSet(), outputFilename);
+        }
+        else {
+            MS::Serializer::writeFile(document.frameSet(), outputFilename);
+        }
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "error: " << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
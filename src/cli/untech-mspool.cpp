@@ -0,0 +1,163 @@
+#include "../models/metasprite.h"
+#include "../models/sprite-importer.h"
+#include "../models/utsi2utms/sharedtilepool.h"
+#include "../models/common/atomicofstream.h"
+#include "../models/common/file.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace UnTech;
+
+namespace MS = UnTech::MetaSprite;
+
+void usage(const char* argv0)
+{
+    auto s = File::splitFilename(argv0);
+
+    std::cerr << "usage: " << s.second << " [-p <pool file> -m <tile map file>] <input files...>\n"
+              << "\n"
+              << "Deduplicates the tiles of the metasprite files into a single shared tile pool\n"
+              << "and prints the number of ROM bytes saved. The input files are not modified.\n"
+              << "\n"
+              << "If a pool file is given, the pool is written to it as a frameset with no\n"
+              << "frames and the tile map file lists the pool tile of every tile used by\n"
+              << "the input files:\n"
+              << "\n"
+              << "    frameset <input file>\n"
+              << "    small|large <tile id> <pool tile id> <hflip> <vflip>\n"
+              << "\n"
+              << "The frameset's tile is the pool tile flipped by hflip/vflip (0 or 1).\n"
+              << "Unused tiles are not listed.\n";
+}
+
+template <class PoolTileVector>
+void writeTileMap(std::ostream& out, const char* tilesetName, const PoolTileVector& tiles)
+{
+    for (unsigned i = 0; i < tiles.size(); i++) {
+        const auto& pt = tiles[i];
+
+        if (pt.used) {
+            out << tilesetName << ' ' << i << ' ' << pt.tileId << ' '
+                << pt.hFlip << ' ' << pt.vFlip << '\n';
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string poolFilename;
+    std::string tileMapFilename;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "-p") == 0 || strcmp(arg, "-m") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            if (arg[1] == 'p') {
+                poolFilename = argv[++i];
+            }
+            else {
+                tileMapFilename = argv[++i];
+            }
+        }
+        else if (arg[0] == '-') {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (inputs.empty() || poolFilename.empty() != tileMapFilename.empty()) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try {
+        // Do not overwrite an input file or the other output
+        if (!poolFilename.empty()) {
+            const std::string poolPath = File::fullPath(poolFilename);
+            const std::string tileMapPath = File::fullPath(tileMapFilename);
+
+            if (poolPath == tileMapPath) {
+                throw std::runtime_error("The pool and tile map files are the same file");
+            }
+
+            for (const std::string& filename : inputs) {
+                const std::string path = File::fullPath(filename);
+
+                if (path == poolPath || path == tileMapPath) {
+                    throw std::runtime_error(filename + " is both an input and an output file");
+                }
+            }
+        }
+
+        SharedTilePool pool;
+
+        for (const std::string& filename : inputs) {
+            try {
+                MS::MetaSpriteDocument document(filename);
+
+                const auto fs = pool.addFrameSet(document.frameSet());
+
+                std::cout << filename << ": "
+                          << fs.nSmallTiles << " small tiles (" << fs.nNewSmallTiles << " new), "
+                          << fs.nLargeTiles << " large tiles (" << fs.nNewLargeTiles << " new)\n";
+            }
+            catch (const std::exception& ex) {
+                throw std::runtime_error(filename + ": " + ex.what());
+            }
+        }
+
+        const auto& stats = pool.statistics();
+
+        std::cout << stats.nFrameSets << " framesets: "
+                  << "small tiles " << stats.nSmallTilesBefore << " -> " << stats.nSmallTiles << ", "
+                  << "large tiles " << stats.nLargeTilesBefore << " -> " << stats.nLargeTiles << ", "
+                  << "ROM bytes " << stats.romBytesBefore() << " -> " << stats.romBytesAfter()
+                  << " (" << stats.romBytesSaved() << " saved)\n";
+
+        if (!poolFilename.empty()) {
+            std::string poolName = File::splitFilename(poolFilename).second;
+            auto ext = poolName.rfind('.');
+            if (ext != std::string::npos && ext != 0) {
+                poolName.erase(ext);
+            }
+
+            MS::MetaSpriteDocument poolDocument;
+            poolDocument.frameSet().setName(poolName);
+            poolDocument.frameSet().smallTileset() = pool.smallTileset();
+            poolDocument.frameSet().largeTileset() = pool.largeTileset();
+
+            poolDocument.writeDataFile(poolFilename);
+
+            AtomicOfStream tileMap(tileMapFilename);
+
+            for (unsigned i = 0; i < inputs.size(); i++) {
+                const SharedTilePool::TileMap& tm = pool.tileMaps().at(i);
+
+                tileMap << "frameset " << inputs[i] << '\n';
+                writeTileMap(tileMap, "small", tm.smallTiles);
+                writeTileMap(tileMap, "large", tm.largeTiles);
+            }
+
+            tileMap.commit();
+        }
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "error: " << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
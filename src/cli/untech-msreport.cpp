@@ -0,0 +1,148 @@
+#include "../models/metasprite.h"
+#include "../models/metasprite/scanlineusage.h"
+#include "../models/metasprite/tilesetorder.h"
+#include "../models/common/file.h"
+#include "../models/common/string.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace UnTech;
+
+namespace MS = UnTech::MetaSprite;
+
+typedef MS::FrameScanlineUsage::Limits Limits;
+
+void usage(const char* argv0)
+{
+    auto s = File::splitFilename(argv0);
+
+    std::cerr << "usage: " << s.second << " [-r <objects>] [-t <slivers>] [-n <objects>] <input files...>\n"
+              << "\n"
+              << "Prints the per-scanline object usage and the DMA transfers required to load\n"
+              << "the tiles of each frame in the metasprite files.\n"
+              << "\n"
+              << "  -r  the maximum number of objects on a scanline (default "
+              << MS::FrameScanlineUsage::MAX_OBJECTS_PER_LINE << ")\n"
+              << "  -t  the maximum number of 8px slivers on a scanline (default "
+              << MS::FrameScanlineUsage::MAX_SLIVERS_PER_LINE << ")\n"
+              << "  -n  the maximum number of objects in a frame (default "
+              << MS::FrameScanlineUsage::MAX_OAM_OBJECTS << ")\n"
+              << "\n"
+              << "The exit status is non-zero if any frame is over the limits.\n";
+}
+
+// returns true if any frame is over the limits
+bool printReport(const std::string& filename, const MS::FrameSet& frameSet, const Limits& limits)
+{
+    const MS::FrameSetScanlineUsage usage(frameSet);
+
+    std::cout << filename << ": " << frameSet.name() << '\n'
+              << "  " << usage.frames().size() << " frames, "
+              << "max " << usage.maxObjects() << " objects per frame, "
+              << "max " << usage.maxObjectsPerLine() << " objects per line, "
+              << "max " << usage.maxSliversPerLine() << " slivers per line, "
+              << usage.nFramesOverLimits(limits) << " frames over limits\n";
+
+    unsigned maxTransfers = 0;
+    unsigned maxBytes = 0;
+
+    for (const auto& it : usage.frames()) {
+        const std::string& name = it.first;
+        const MS::FrameScanlineUsage& fu = it.second;
+        const MS::FrameDmaUsage dma = MS::frameDmaUsage(frameSet.frames().at(name));
+
+        maxTransfers = std::max(maxTransfers, dma.nTransfers);
+        maxBytes = std::max(maxBytes, dma.nBytes);
+
+        std::cout << "  " << std::left << std::setw(20) << name << std::right
+                  << " objects " << std::setw(3) << fu.nObjects()
+                  << "  objects/line " << std::setw(3) << fu.maxObjectsPerLine()
+                  << "  slivers/line " << std::setw(3) << fu.maxSliversPerLine()
+                  << "  DMA " << std::setw(2) << dma.nTransfers
+                  << " transfers " << std::setw(5) << dma.nBytes << " bytes";
+
+        if (fu.nObjects() > 0) {
+            std::cout << "  worst line " << fu.worstLine();
+        }
+        if (fu.nObjects() > limits.oamObjects) {
+            std::cout << "  TOO MANY OBJECTS";
+        }
+        std::cout << '\n';
+
+        for (const auto& run : fu.linesOverLimits(limits)) {
+            std::cout << "      over limits: lines " << run.first << " to " << run.second << '\n';
+        }
+    }
+
+    std::cout << "  max " << maxTransfers << " DMA transfers, max " << maxBytes << " DMA bytes per frame\n";
+
+    return usage.nFramesOverLimits(limits) > 0;
+}
+
+int main(int argc, char* argv[])
+{
+    Limits limits;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "-r") == 0 || strcmp(arg, "-t") == 0 || strcmp(arg, "-n") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            auto v = String::toInt(argv[++i]);
+            if (!v.second || v.first < 0) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            if (arg[1] == 'r') {
+                limits.objectsPerLine = v.first;
+            }
+            else if (arg[1] == 't') {
+                limits.sliversPerLine = v.first;
+            }
+            else {
+                limits.oamObjects = v.first;
+            }
+        }
+        else if (arg[0] == '-') {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (inputs.empty()) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bool overLimits = false;
+    bool error = false;
+
+    for (const std::string& filename : inputs) {
+        try {
+            MS::MetaSpriteDocument document(filename);
+
+            overLimits |= printReport(filename, document.frameSet(), limits);
+        }
+        catch (const std::exception& ex) {
+            std::cerr << filename << ": error: " << ex.what() << '\n';
+            error = true;
+        }
+    }
+
+    return (error || overLimits) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,10 +1,26 @@
 #include "../models/sprite-importer.h"
 #include "../models/metasprite.h"
+#include "../models/sprite-importer/frameobjectcover.h"
 #include "../models/utsi2utms/utsi2utms.h"
+#include "../models/utsi2utms/utsi2utmscache.h"
+#include "../models/common/atomicofstream.h"
 #include "../models/common/file.h"
 #include "../models/common/namedlist.h"
+#include "../models/common/parallelfor.h"
+#include "../models/common/string.h"
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <list>
+#include <map>
+#include <memory>
 #include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace UnTech;
 
@@ -13,43 +29,382 @@ namespace MS = UnTech::MetaSprite;
 
 // ::TODO version argument::
 
-int main(int argc, char* argv[])
+void usage(const char* argv0)
 {
-    if (argc != 2) {
-        auto s = File::splitFilename(argv[0]);
+    auto s = File::splitFilename(argv0);
+
+    std::cerr << "usage: " << s.second << " [-s] [-a] [-c <cache dir>] <input file>\n"
+              << "       " << s.second << " [-s] [-a] [-c <cache dir>] [-j <jobs>] [-m <manifest>] -o <output dir> [input files...]\n"
+              << "\n"
+              << "In batch mode each input file is converted into `<output dir>/<name>.utms`,\n"
+              << "the input files must have different names.\n"
+              << "The manifest is a text file containing one input file per line.\n"
+              << "If a cache directory is given then unchanged framesets are not reconverted.\n"
+              << "The -s option prints the tileset hash statistics of each converted frameset.\n"
+              << "The -a option replaces the frame objects with automatically generated ones\n"
+              << "(the cache is not used).\n";
+}
 
-        std::cerr << "usage: " << s.second << " <input file>" << std::endl;
+struct Job {
+    std::string inputFilename;
+    std::string outputFilename;
 
-        return EXIT_FAILURE;
+    std::string msXml;
+    std::list<std::string> warnings;
+    std::list<std::string> errors;
+    bool success = false;
+
+    // only set if the frameset was converted
+    bool hasStatistics = false;
+    TileHashStatistics smallTileHashStatistics;
+    TileHashStatistics largeTileHashStatistics;
+};
+
+void printStatistics(const std::string& name, const TileHashStatistics& stats)
+{
+    std::cerr << name << ": "
+              << stats.nTiles << " tiles, "
+              << stats.nUsedBuckets << "/" << stats.nBuckets << " buckets used, "
+              << "max bucket size " << stats.maxBucketSize << ", "
+              << stats.nBucketCollisions << " bucket collisions, "
+              << stats.nFingerprintCollisions << " fingerprint collisions\n";
+}
+
+void printStatistics(const Job& job, const std::string& prefix)
+{
+    if (job.hasStatistics) {
+        printStatistics(prefix + "small tileset", job.smallTileHashStatistics);
+        printStatistics(prefix + "large tileset", job.largeTileHashStatistics);
     }
+}
+
+void generateFrameObjects(SI::FrameSet& frameSet)
+{
+    SI::FrameObjectCover cover;
+
+    for (auto frameIt : frameSet.frames()) {
+        cover.apply(frameIt.second);
+    }
+}
+
+void processJob(Job& job, const Utsi2UtmsCache* cache, unsigned nThreads, bool autoCover)
+{
+    try {
+        std::string cacheKey;
+
+        if (cache) {
+            cacheKey = cache->lookupKey(job.inputFilename);
+
+            if (!cacheKey.empty() && cache->fetch(cacheKey, job.msXml, job.warnings)) {
+                job.success = true;
+                return;
+            }
+        }
+
+        SI::SpriteImporterDocument siDocument(job.inputFilename);
+
+        if (autoCover) {
+            generateFrameObjects(siDocument.frameSet());
+        }
+
+        if (cache && cacheKey.empty()) {
+            cacheKey = cache->calculateKey(siDocument.frameSet(), job.inputFilename);
+
+            if (cache->fetch(cacheKey, job.msXml, job.warnings)) {
+                job.success = true;
+                return;
+            }
+        }
+
+        UnTech::Utsi2Utms converter;
+        converter.setThreadCount(nThreads);
+
+        std::unique_ptr<MS::MetaSpriteDocument> msDocument = converter.convert(siDocument);
+
+        job.warnings = converter.warnings();
+        job.errors = converter.errors();
 
-    const char* filename = argv[1];
+        job.hasStatistics = true;
+        job.smallTileHashStatistics = converter.smallTileHashStatistics();
+        job.largeTileHashStatistics = converter.largeTileHashStatistics();
 
-    UnTech::Utsi2Utms converter;
+        if (msDocument == nullptr) {
+            job.errors.push_back("Error processing frameset.");
+            return;
+        }
 
-    SI::SpriteImporterDocument siDocument(filename);
-    std::unique_ptr<MS::MetaSpriteDocument> msDocument = converter.convert(siDocument);
+        if (!converter.errors().empty()) {
+            return;
+        }
 
-    for (const std::string& w : converter.warnings()) {
+        // Does not use the document's write functions ATM
+        // as this app just combines the documents in one sitting.
+        std::stringstream out;
+        MS::Serializer::writeFile(msDocument->frameSet(), out);
+        job.msXml = out.str();
+
+        if (cache) {
+            cache->store(cacheKey, job.msXml, job.warnings);
+        }
+
+        job.success = true;
+    }
+    catch (const std::exception& ex) {
+        job.errors.push_back(ex.what());
+    }
+}
+
+/*
+ * SINGLE FILE MODE
+ * ================
+ */
+
+int convertSingleFile(const std::string& filename, const Utsi2UtmsCache* cache,
+                      bool autoCover, bool showStatistics)
+{
+    Job job;
+    job.inputFilename = filename;
+
+    processJob(job, cache, 0, autoCover);
+
+    for (const std::string& w : job.warnings) {
         std::cerr << "warning: " << w << '\n';
     }
 
-    for (const std::string& e : converter.errors()) {
+    for (const std::string& e : job.errors) {
         std::cerr << "error: " << e << '\n';
     }
 
-    if (msDocument == nullptr) {
-        std::cerr << "Error processing frameset.\n";
-        return EXIT_FAILURE;
+    if (showStatistics) {
+        printStatistics(job, std::string());
     }
 
-    if (!converter.errors().empty()) {
+    if (!job.success) {
         return EXIT_FAILURE;
     }
 
-    // Does not use the document's write functions ATM
-    // as this app just combines the documents in one sitting.
-    MS::Serializer::writeFile(msDocument->frameSet(), std::cout);
+    std::cout << job.msXml;
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * BATCH MODE
+ * ==========
+ */
+
+std::string outputFilenameFor(const std::string& outputDir, const std::string& inputFilename)
+{
+    std::string name = File::splitFilename(inputFilename).second;
+
+    auto ext = name.rfind('.');
+    if (ext != std::string::npos && ext != 0) {
+        name.erase(ext);
+    }
+
+    return File::joinPath(outputDir, name + ".utms");
+}
+
+// Throws an exception if two jobs write to the same output file.
+void checkOutputFilenames(const std::vector<Job>& jobs)
+{
+    std::map<std::string, const Job*> outputs;
+
+    for (const Job& job : jobs) {
+        const auto it = outputs.emplace(File::fullPath(job.outputFilename), &job);
+
+        if (!it.second) {
+            throw std::runtime_error(job.inputFilename + " and " + it.first->second->inputFilename
+                                     + " have the same output filename: " + job.outputFilename);
+        }
+    }
+}
+
+// Reads a manifest file, one input filename per line.
+// Blank lines and lines starting with '#' are ignored.
+// Relative filenames are relative to the manifest's directory.
+void readManifest(const std::string& filename, std::vector<std::string>& inputs)
+{
+    std::ifstream in(filename);
+    if (!in) {
+        throw std::runtime_error(filename + ": Cannot open manifest");
+    }
+
+    const std::string dir = File::splitFilename(File::fullPath(filename)).first;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        const auto start = line.find_first_not_of(" \t\r\n");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        const auto end = line.find_last_not_of(" \t\r\n");
+
+        inputs.push_back(File::joinPath(dir, line.substr(start, end - start + 1)));
+    }
+}
+
+void processBatchJob(Job& job, const Utsi2UtmsCache* cache, bool autoCover)
+{
+    // The framesets are already processed in parallel.
+    processJob(job, cache, 1, autoCover);
+
+    if (job.success) {
+        try {
+            AtomicOfStream file(job.outputFilename);
+            file << job.msXml;
+            file.commit();
+        }
+        catch (const std::exception& ex) {
+            job.errors.push_back(ex.what());
+            job.success = false;
+        }
+    }
+
+    // release memory early
+    job.msXml = std::string();
+}
+
+int convertBatch(std::vector<Job>& jobs, unsigned nThreads, const Utsi2UtmsCache* cache,
+                 bool autoCover, bool showStatistics)
+{
+    // Jobs are handed out in order, one frameset per worker.
+    parallelFor(jobs.size(), nThreads, [&](size_t i) {
+        processBatchJob(jobs[i], cache, autoCover);
+    });
+
+    // Messages are reported in input order, regardless of which thread
+    // processed the job.
+    unsigned nFailed = 0;
+
+    for (const Job& job : jobs) {
+        for (const std::string& w : job.warnings) {
+            std::cerr << job.inputFilename << ": warning: " << w << '\n';
+        }
+        for (const std::string& e : job.errors) {
+            std::cerr << job.inputFilename << ": error: " << e << '\n';
+        }
+
+        if (showStatistics) {
+            printStatistics(job, job.inputFilename + ": ");
+        }
+
+        if (!job.success) {
+            nFailed++;
+        }
+    }
+
+    if (nFailed > 0) {
+        std::cerr << nFailed << " of " << jobs.size() << " framesets failed.\n";
+        return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
 }
+
+int main(int argc, char* argv[])
+{
+    std::string outputDir;
+    std::string cacheDir;
+    std::vector<std::string> inputs;
+    unsigned nThreads = 0;
+    bool batchMode = false;
+    bool autoCover = false;
+    bool showStatistics = false;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            const char* arg = argv[i];
+
+            if (strcmp(arg, "-s") == 0) {
+                showStatistics = true;
+            }
+            else if (strcmp(arg, "-a") == 0) {
+                autoCover = true;
+            }
+            else if (strcmp(arg, "-c") == 0) {
+                if (i + 1 >= argc) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                cacheDir = argv[++i];
+            }
+            else if (strcmp(arg, "-o") == 0 || strcmp(arg, "-j") == 0 || strcmp(arg, "-m") == 0) {
+                if (i + 1 >= argc) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                const char* value = argv[++i];
+
+                batchMode = true;
+
+                if (arg[1] == 'o') {
+                    outputDir = value;
+                }
+                else if (arg[1] == 'j') {
+                    auto j = String::toInt(value);
+                    if (!j.second || j.first <= 0) {
+                        usage(argv[0]);
+                        return EXIT_FAILURE;
+                    }
+                    nThreads = j.first;
+                }
+                else {
+                    readManifest(value, inputs);
+                }
+            }
+            else if (arg[0] == '-') {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            else {
+                inputs.push_back(arg);
+            }
+        }
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "error: " << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<Utsi2UtmsCache> cache;
+    // The cached file stats do not know about the generated frame objects
+    if (!cacheDir.empty() && !autoCover) {
+        cache = std::make_unique<Utsi2UtmsCache>(cacheDir);
+    }
+
+    if (!batchMode) {
+        if (inputs.size() != 1) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        return convertSingleFile(inputs.front(), cache.get(), autoCover, showStatistics);
+    }
+
+    if (outputDir.empty() || inputs.empty()) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (nThreads == 0) {
+        nThreads = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    std::vector<Job> jobs(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        jobs[i].inputFilename = inputs[i];
+        jobs[i].outputFilename = outputFilenameFor(outputDir, inputs[i]);
+    }
+
+    // The jobs are processed in parallel, they must not share an output file
+    try {
+        checkOutputFilenames(jobs);
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "error: " << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return convertBatch(jobs, nThreads, cache.get(), autoCover, showStatistics);
+}
@@ -11,6 +11,8 @@
 #include "models/common/orderedlist.h"
 
 #include <cassert>
+#include <memory>
+#include <vector>
 #include <sigc++/signal.h>
 
 namespace UnTech {
@@ -324,6 +326,99 @@ inline void orderedList_moveDown(typename T::list_t* list,
         }
     }
 }
+
+/*
+ * Replaces all of the items in the list with the items created by
+ * `createItems(list)`.
+ */
+template <class T, class CreateFunc>
+inline void orderedList_replaceAll(typename T::list_t* list,
+                                   const CreateFunc& createItems,
+                                   const typename sigc::signal<void, const typename T::list_t*>& listChangedSignal,
+                                   const Glib::ustring& message)
+{
+    typedef std::vector<std::unique_ptr<Private::OrderedListAddRemove<T>>> handlerList_t;
+
+    class Action : public ::UnTech::Undo::Action {
+    public:
+        Action() = delete;
+        Action(
+            handlerList_t&& oldItems, handlerList_t&& newItems,
+            typename T::list_t* list,
+            const typename sigc::signal<void, const typename T::list_t*>& listChangedSignal,
+            const Glib::ustring& message)
+            : _oldItems(std::move(oldItems))
+            , _newItems(std::move(newItems))
+            , _list(list)
+            , _listChangedSignal(listChangedSignal)
+            , _message(message)
+        {
+        }
+
+        virtual ~Action() override = default;
+
+        virtual void undo() override
+        {
+            swapItems(_newItems, _oldItems);
+            _listChangedSignal.emit(_list);
+        }
+
+        virtual void redo() override
+        {
+            swapItems(_oldItems, _newItems);
+            _listChangedSignal.emit(_list);
+        }
+
+        virtual const Glib::ustring& message() const override { return _message; }
+
+    private:
+        // the handlers are in index order
+        static void swapItems(handlerList_t& toRemove, handlerList_t& toAdd)
+        {
+            for (auto it = toRemove.rbegin(); it != toRemove.rend(); ++it) {
+                (*it)->remove();
+            }
+            for (auto& h : toAdd) {
+                h->add();
+            }
+        }
+
+    private:
+        handlerList_t _oldItems;
+        handlerList_t _newItems;
+        typename T::list_t* _list;
+        const typename sigc::signal<void, const typename T::list_t*>& _listChangedSignal;
+        const Glib::ustring _message;
+    };
+
+    UnTech::Undo::UndoDocument* undoDoc = nullptr;
+
+    handlerList_t oldItems;
+    for (T& item : *list) {
+        oldItems.push_back(std::make_unique<Private::OrderedListAddRemove<T>>(list, &item));
+        undoDoc = dynamic_cast<UnTech::Undo::UndoDocument*>(&(item.document()));
+    }
+    for (auto it = oldItems.rbegin(); it != oldItems.rend(); ++it) {
+        (*it)->remove();
+    }
+
+    createItems(*list);
+
+    handlerList_t newItems;
+    for (T& item : *list) {
+        newItems.push_back(std::make_unique<Private::OrderedListAddRemove<T>>(list, &item));
+        undoDoc = dynamic_cast<UnTech::Undo::UndoDocument*>(&(item.document()));
+    }
+
+    listChangedSignal.emit(list);
+
+    if (undoDoc) {
+        auto a = std::make_unique<Action>(std::move(oldItems), std::move(newItems),
+                                          list, listChangedSignal, message);
+
+        undoDoc->undoStack().add_undo(std::move(a));
+    }
+}
 }
 }
 
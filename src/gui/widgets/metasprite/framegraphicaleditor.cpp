@@ -2,7 +2,9 @@
 #include "signals.h"
 #include "gui/undo/actionhelper.h"
 #include "../common/cr_rgba.h"
+#include "models/metasprite/scanlineusage.h"
 
+#include <algorithm>
 #include <cmath>
 
 using namespace UnTech::Widgets::MetaSprite;
@@ -10,6 +12,13 @@ using namespace UnTech::Widgets::MetaSprite;
 const unsigned FRAME_IMAGE_SIZE = 256 + 16;
 const unsigned FRAME_IMAGE_OFFSET = -UnTech::int_ms8_t::MIN;
 
+inline UnTech::urect frameObjectArea(const UnTech::MetaSprite::FrameObject& obj)
+{
+    return UnTech::urect(FRAME_IMAGE_OFFSET + obj.location().x,
+                         FRAME_IMAGE_OFFSET + obj.location().y,
+                         obj.sizePx(), obj.sizePx());
+}
+
 SIMPLE_UNDO_ACTION(frameObject_setLocation,
                    MS::FrameObject, UnTech::ms8point, location, setLocation,
                    Signals::frameObjectChanged,
@@ -34,9 +43,12 @@ FrameGraphicalEditor::FrameGraphicalEditor(Selection& selection)
     , _displayZoom(NAN)
     , _frameNameFont("Monospace Bold")
     , _frameImageBuffer(FRAME_IMAGE_SIZE, FRAME_IMAGE_SIZE)
+    , _frameScaler()
     , _framePixbuf()
+    , _objectAreas()
     , _centerX()
     , _centerY()
+    , _showScanlineUsage(false)
 {
     set_hexpand(true);
     set_vexpand(true);
@@ -86,7 +98,7 @@ FrameGraphicalEditor::FrameGraphicalEditor(Selection& selection)
 
     Signals::frameObjectChanged.connect([this](const MS::FrameObject* obj) {
         if (obj && &obj->frame() == _selectedFrame) {
-            redrawFramePixbuf();
+            redrawFrameObject(obj);
         }
     });
 
@@ -130,23 +142,70 @@ void FrameGraphicalEditor::redrawFramePixbuf()
         _selectedFrame->draw(_frameImageBuffer, *_selection.palette(),
                              FRAME_IMAGE_OFFSET, FRAME_IMAGE_OFFSET);
 
-        auto pixbuf = Gdk::Pixbuf::create_from_data(reinterpret_cast<const guint8*>(_frameImageBuffer.data()),
-                                                    Gdk::Colorspace::COLORSPACE_RGB, true, 8,
-                                                    FRAME_IMAGE_SIZE, FRAME_IMAGE_SIZE,
-                                                    FRAME_IMAGE_SIZE * 4);
+        // Scaling is done by ImageScaler not Cairo, as it results in sharp pixels
+        const Image& scaled = _frameScaler.scale(_frameImageBuffer,
+                                                 FRAME_IMAGE_SIZE * _zoomX,
+                                                 FRAME_IMAGE_SIZE * _zoomY);
 
-        // Scaling is done by GTK not Cairo, as it results in sharp pixels
-        _framePixbuf = pixbuf->scale_simple(FRAME_IMAGE_SIZE * _zoomX,
-                                            FRAME_IMAGE_SIZE * _zoomY,
-                                            Gdk::InterpType::INTERP_NEAREST);
+        _framePixbuf = Gdk::Pixbuf::create_from_data(reinterpret_cast<const guint8*>(scaled.data()),
+                                                     Gdk::Colorspace::COLORSPACE_RGB, true, 8,
+                                                     scaled.size().width, scaled.size().height,
+                                                     scaled.size().width * 4);
+
+        _objectAreas.clear();
+        for (const MS::FrameObject& obj : _selectedFrame->objects()) {
+            _objectAreas[&obj] = frameObjectArea(obj);
+        }
     }
     else {
         _framePixbuf.reset();
+        _objectAreas.clear();
     }
 
     queue_draw();
 }
 
+void FrameGraphicalEditor::redrawFrameObject(const MS::FrameObject* obj)
+{
+    auto it = _objectAreas.find(obj);
+
+    if (!_framePixbuf || !_selection.palette() || it == _objectAreas.end()) {
+        redrawFramePixbuf();
+        return;
+    }
+
+    const urect oldArea = it->second;
+    const urect newArea = frameObjectArea(*obj);
+    it->second = newArea;
+
+    const unsigned left = std::min(oldArea.left(), newArea.left());
+    const unsigned top = std::min(oldArea.top(), newArea.top());
+    const unsigned right = std::max(oldArea.right(), newArea.right());
+    const unsigned bottom = std::max(oldArea.bottom(), newArea.bottom());
+
+    redrawFramePixbufArea(urect(left, top, right - left, bottom - top));
+}
+
+void FrameGraphicalEditor::redrawFramePixbufArea(const urect& area)
+{
+    // Draw the area into a temporary image so the objects are clipped to it.
+    UnTech::Image areaImage(area.width, area.height);
+    areaImage.fill(0);
+    _selectedFrame->draw(areaImage, *_selection.palette(),
+                         int(FRAME_IMAGE_OFFSET) - int(area.x),
+                         int(FRAME_IMAGE_OFFSET) - int(area.y));
+
+    for (unsigned y = 0; y < area.height; y++) {
+        std::copy_n(areaImage.scanline(y), area.width,
+                    _frameImageBuffer.scanline(area.y + y) + area.x);
+    }
+
+    // _framePixbuf shares its data with _frameScaler
+    _frameScaler.scaleArea(_frameImageBuffer, area);
+
+    queue_draw();
+}
+
 bool FrameGraphicalEditor::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
 {
     // ::TODO move::
@@ -166,6 +225,12 @@ bool FrameGraphicalEditor::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
     const cr_rgba originColor1 = { 0.0, 0.0, 0.0, 0.2 };
     const cr_rgba originColor2 = { 1.0, 1.0, 1.0, 0.2 };
 
+    const double SLIVER_BAR_WIDTH = 2.0;
+    const cr_rgba scanlineOkColor = { 0.2, 0.8, 0.2, 0.6 };
+    const cr_rgba scanlineNearLimitColor = { 0.9, 0.6, 0.0, 0.7 };
+    const cr_rgba scanlineOverLimitColor = { 0.9, 0.0, 0.0, 0.8 };
+    const cr_rgba scanlineOverLimitFillColor = { 0.9, 0.0, 0.0, 0.2 };
+
     if (std::isnan(_displayZoom)) {
         auto screen = get_screen();
 
@@ -211,6 +276,48 @@ bool FrameGraphicalEditor::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
 
     const MS::Frame* frame = _selectedFrame;
 
+    // A bar on the left edge for each scanline, one unit per sliver.
+    // Lines that are over the hardware limits are highlighted.
+    if (_showScanlineUsage) {
+        const MS::FrameScanlineUsage usage(*frame);
+        const MS::FrameScanlineUsage::Limits limits;
+
+        const double aWidth = allocation.get_width() / _displayZoom;
+
+        cr->save();
+
+        for (unsigned i = 0; i < usage.lines().size(); i++) {
+            const auto& line = usage.lines()[i];
+
+            if (line.nObjects == 0) {
+                continue;
+            }
+
+            const int y = int(i) + MS::FrameScanlineUsage::FIRST_LINE;
+            const double zY = (y + _yOffset) * _zoomY;
+
+            if (usage.lineOverLimits(y, limits)) {
+                cr->rectangle(0, zY, aWidth, _zoomY);
+                scanlineOverLimitFillColor.apply(cr);
+                cr->fill();
+
+                scanlineOverLimitColor.apply(cr);
+            }
+            else if (line.nSlivers * 4 > limits.sliversPerLine * 3
+                     || line.nObjects * 4 > limits.objectsPerLine * 3) {
+                scanlineNearLimitColor.apply(cr);
+            }
+            else {
+                scanlineOkColor.apply(cr);
+            }
+
+            cr->rectangle(0, zY, line.nSlivers * SLIVER_BAR_WIDTH * _zoomX, _zoomY);
+            cr->fill();
+        }
+
+        cr->restore();
+    }
+
     cr->set_line_width(ITEM_WIDTH);
 
     if (frame->solid()) {
@@ -858,6 +965,14 @@ void FrameGraphicalEditor::setCenter(int x, int y)
     }
 }
 
+void FrameGraphicalEditor::setShowScanlineUsage(bool showScanlineUsage)
+{
+    if (_showScanlineUsage != showScanlineUsage) {
+        _showScanlineUsage = showScanlineUsage;
+        queue_draw();
+    }
+}
+
 void FrameGraphicalEditor::update_offsets()
 {
     const auto allocation = get_allocation();
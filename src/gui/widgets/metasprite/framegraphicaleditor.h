@@ -2,8 +2,10 @@
 #define _UNTECH_GUI_WIDGETS_METASPRITE_FRAMEGRAPHICALEDITOR_H_
 
 #include "selection.h"
+#include "models/common/imagescaler.h"
 #include "gui/widgets/defaults.h"
 
+#include <map>
 #include <gtkmm.h>
 
 namespace UnTech {
@@ -24,6 +26,8 @@ public:
 
     void setCenter(int x, int y);
 
+    void setShowScanlineUsage(bool showScanlineUsage);
+
 protected:
     struct Action {
         enum State {
@@ -47,6 +51,10 @@ protected:
 
     void redrawFramePixbuf();
 
+    // Only redraws the old and new area of the frame object.
+    void redrawFrameObject(const MS::FrameObject* obj);
+    void redrawFramePixbufArea(const urect& area);
+
     bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr) override;
 
     bool on_button_press_event(GdkEventButton* event) override;
@@ -83,13 +91,21 @@ private:
     /** A placeholder image to draw the frame onto*/
     UnTech::Image _frameImageBuffer;
 
+    /** Scales the frame image, owns the data of _framePixbuf. */
+    UnTech::ImageScaler _frameScaler;
+
     /** A pre-scaled copy of the frame image. */
     Glib::RefPtr<Gdk::Pixbuf> _framePixbuf;
 
+    /** The area of each frame object in _frameImageBuffer when it was last drawn. */
+    std::map<const MS::FrameObject*, urect> _objectAreas;
+
     // The user supplied X/Y offset
     // on zoom/resize the _xOffset/_yOffset variables are changed.
     int _centerX, _centerY;
 
+    bool _showScanlineUsage;
+
     Action _action;
 };
 }
@@ -143,6 +143,11 @@ void MetaSpriteApplication::on_menu_open()
     filterUtms->add_pattern("*.utms");
     dialog.add_filter(filterUtms);
 
+    auto filterUtmb = Gtk::FileFilter::create();
+    filterUtmb->set_name(_("UnTech Binary MetaSprite File"));
+    filterUtmb->add_pattern("*.utmb");
+    dialog.add_filter(filterUtmb);
+
     auto filterAny = Gtk::FileFilter::create();
     filterAny->set_name(_("All files"));
     filterAny->add_pattern("*");
@@ -238,6 +243,12 @@ const Glib::ustring MetaSpriteApplication::_uiInfo
       "          <attribute name='action'>win.move-selected-down</attribute>"
       "        </item>"
       "      </section>"
+      "      <section>"
+      "        <item>"
+      "          <attribute name='label' translatable='yes'>Remove Unused _Tiles</attribute>"
+      "          <attribute name='action'>win.remove-unused-tiles</attribute>"
+      "        </item>"
+      "      </section>"
       "    </submenu>"
       "    <submenu>"
       "      <attribute name='label' translatable='yes'>_View</attribute>"
@@ -323,6 +334,10 @@ const Glib::ustring MetaSpriteApplication::_uiInfo
       "        <attribute name='label' translatable='yes'>_Split View</attribute>"
       "        <attribute name='action'>win.split-view</attribute>"
       "      </item>"
+      "      <item>"
+      "        <attribute name='label' translatable='yes'>Show Scanline _Usage</attribute>"
+      "        <attribute name='action'>win.show-scanline-usage</attribute>"
+      "      </item>"
       "    </submenu>"
       "    <submenu>"
       "      <attribute name='label' translatable='yes'>_Help</attribute>"
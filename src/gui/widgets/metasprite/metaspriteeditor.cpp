@@ -256,6 +256,12 @@ void MetaSpriteEditor::setShowTwoEditors(bool showTwoEditors)
     }
 }
 
+void MetaSpriteEditor::setShowScanlineUsage(bool showScanlineUsage)
+{
+    _graphicalEditor0.setShowScanlineUsage(showScanlineUsage);
+    _graphicalEditor1.setShowScanlineUsage(showScanlineUsage);
+}
+
 void MetaSpriteEditor::on_scroll_changed()
 {
     _graphicalEditor0.setCenter(_graphicalHScroll.get_value(),
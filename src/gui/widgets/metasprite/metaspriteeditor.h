@@ -40,6 +40,7 @@ public:
     void setDocument(std::unique_ptr<Document> document);
 
     void setShowTwoEditors(bool showTwoEditors);
+    void setShowScanlineUsage(bool showScanlineUsage);
     void setZoom(int zoom, double aspectRatio);
 
 protected:
@@ -57,6 +57,11 @@ MetaSpriteWindow::MetaSpriteWindow()
         sigc::hide(sigc::mem_fun(_editor.selection(), &Selection::moveSelectedDown)));
     add_action(_moveSelectedDownAction);
 
+    _removeUnusedTilesAction = Gio::SimpleAction::create("remove-unused-tiles");
+    _removeUnusedTilesAction->signal_activate().connect(
+        sigc::hide(sigc::mem_fun(_editor.selection(), &Selection::removeUnusedTiles)));
+    add_action(_removeUnusedTilesAction);
+
     _zoomAction = add_action_radio_integer(
         "set-zoom", sigc::mem_fun(*this, &MetaSpriteWindow::do_setZoom), DEFAULT_ZOOM);
 
@@ -66,6 +71,9 @@ MetaSpriteWindow::MetaSpriteWindow()
     _splitViewAction = add_action_bool(
         "split-view", sigc::mem_fun(*this, &MetaSpriteWindow::do_splitView), false);
 
+    _showScanlineUsageAction = add_action_bool(
+        "show-scanline-usage", sigc::mem_fun(*this, &MetaSpriteWindow::do_showScanlineUsage), false);
+
     updateItemActions();
     updateUndoActions();
     updateGuiZoom();
@@ -153,6 +161,7 @@ void MetaSpriteWindow::updateItemActions()
     _removeSelectedAction->set_enabled(canCrud);
     _moveSelectedUpAction->set_enabled(canMoveUp);
     _moveSelectedDownAction->set_enabled(canMoveDown);
+    _removeUnusedTilesAction->set_enabled(selection.canRemoveUnusedTiles());
 }
 
 void MetaSpriteWindow::do_undo()
@@ -213,6 +222,11 @@ void MetaSpriteWindow::do_saveAs()
         filterUtms->add_pattern("*.utms");
         dialog.add_filter(filterUtms);
 
+        auto filterUtmb = Gtk::FileFilter::create();
+        filterUtmb->set_name(_("UnTech Binary MetaSprite File"));
+        filterUtmb->add_pattern("*.utmb");
+        dialog.add_filter(filterUtmb);
+
         auto filterAny = Gtk::FileFilter::create();
         filterAny->set_name(_("All files"));
         filterAny->add_pattern("*");
@@ -233,6 +247,9 @@ void MetaSpriteWindow::do_saveAs()
             if (dialog.get_filter() == filterUtms && name.find('.') == Glib::ustring::npos) {
                 dialog.set_current_name(name + ".utms");
             }
+            if (dialog.get_filter() == filterUtmb && name.find('.') == Glib::ustring::npos) {
+                dialog.set_current_name(name + ".utmb");
+            }
 
             try {
                 document->saveFile(dialog.get_filename());
@@ -297,6 +314,18 @@ void MetaSpriteWindow::do_splitView()
     _editor.setShowTwoEditors(state);
 }
 
+void MetaSpriteWindow::do_showScanlineUsage()
+{
+    bool state;
+    _showScanlineUsageAction->get_state(state);
+
+    // have to invert state manually
+    state = !state;
+    _showScanlineUsageAction->change_state(state);
+
+    _editor.setShowScanlineUsage(state);
+}
+
 bool MetaSpriteWindow::on_delete_event(GdkEventAny*)
 {
     auto* document = _editor.document();
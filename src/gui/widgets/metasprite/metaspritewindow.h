@@ -38,6 +38,7 @@ protected:
     void do_setZoom(int zoom);
     void do_setAspectRatio(int state);
     void do_splitView();
+    void do_showScanlineUsage();
 
     bool on_delete_event(GdkEventAny* any_event);
 
@@ -53,9 +54,11 @@ private:
     Glib::RefPtr<Gio::SimpleAction> _removeSelectedAction;
     Glib::RefPtr<Gio::SimpleAction> _moveSelectedUpAction;
     Glib::RefPtr<Gio::SimpleAction> _moveSelectedDownAction;
+    Glib::RefPtr<Gio::SimpleAction> _removeUnusedTilesAction;
     Glib::RefPtr<Gio::SimpleAction> _zoomAction;
     Glib::RefPtr<Gio::SimpleAction> _aspectRatioAction;
     Glib::RefPtr<Gio::SimpleAction> _splitViewAction;
+    Glib::RefPtr<Gio::SimpleAction> _showScanlineUsageAction;
 
     sigc::connection _undoStackConnection;
     sigc::connection _updateTitleConnection;
@@ -1,11 +1,125 @@
 #include "selection.h"
 #include "signals.h"
 #include "gui/undo/orderedlistactions.h"
+#include "models/metasprite/tilesetorder.h"
+#include <memory>
+#include <vector>
 #include <glibmm/i18n.h>
 
 using namespace UnTech::Widgets::MetaSprite;
 namespace MS = UnTech::MetaSprite;
 
+// Cannot use a simple undo action as the tilesets and
+// the tileId of every frame object are changed.
+inline void frameSet_removeUnusedTiles(MS::FrameSet* frameSet)
+{
+    struct State {
+        UnTech::Snes::Tileset4bpp8px smallTileset;
+        UnTech::Snes::Tileset4bpp16px largeTileset;
+        std::vector<unsigned> tileIds;
+
+        State(const MS::FrameSet& frameSet, const std::vector<MS::FrameObject*>& objects)
+            : smallTileset(frameSet.smallTileset())
+            , largeTileset(frameSet.largeTileset())
+            , tileIds()
+        {
+            tileIds.reserve(objects.size());
+            for (const MS::FrameObject* obj : objects) {
+                tileIds.push_back(obj->tileId());
+            }
+        }
+    };
+
+    class Action : public ::UnTech::Undo::Action {
+    public:
+        Action() = delete;
+        Action(MS::FrameSet* frameSet,
+               std::vector<MS::FrameObject*>&& objects,
+               State&& oldState, State&& newState)
+            : _frameSet(frameSet)
+            , _objects(std::move(objects))
+            , _oldState(std::move(oldState))
+            , _newState(std::move(newState))
+        {
+        }
+
+        virtual ~Action() override = default;
+
+        virtual void undo() override
+        {
+            apply(_newState, _oldState);
+        }
+
+        virtual void redo() override
+        {
+            apply(_oldState, _newState);
+        }
+
+        virtual const Glib::ustring& message() const override
+        {
+            const static Glib::ustring message = _("Remove Unused Tiles");
+            return message;
+        }
+
+    private:
+        void apply(const State& from, const State& to)
+        {
+            _frameSet->smallTileset() = to.smallTileset;
+            _frameSet->largeTileset() = to.largeTileset;
+
+            for (unsigned i = 0; i < _objects.size(); i++) {
+                _objects[i]->setTileId(to.tileIds[i]);
+            }
+
+            emitSignals(_frameSet, _objects, from.tileIds);
+        }
+
+    public:
+        static void emitSignals(const MS::FrameSet* frameSet,
+                                const std::vector<MS::FrameObject*>& objects,
+                                const std::vector<unsigned>& previousTileIds)
+        {
+            Signals::frameSetTilesetCountChanged.emit(frameSet);
+            Signals::frameSetTilesetChanged.emit(frameSet);
+
+            for (unsigned i = 0; i < objects.size(); i++) {
+                if (objects[i]->tileId() != previousTileIds[i]) {
+                    Signals::frameObjectChanged.emit(objects[i]);
+                }
+            }
+        }
+
+    private:
+        MS::FrameSet* _frameSet;
+        std::vector<MS::FrameObject*> _objects;
+        const State _oldState;
+        const State _newState;
+    };
+
+    if (frameSet) {
+        std::vector<MS::FrameObject*> objects;
+        for (auto frameIt : frameSet->frames()) {
+            for (MS::FrameObject& obj : frameIt.second.objects()) {
+                objects.push_back(&obj);
+            }
+        }
+
+        State oldState(*frameSet, objects);
+
+        if (MS::removeUnusedTiles(*frameSet) > 0) {
+            State newState(*frameSet, objects);
+
+            Action::emitSignals(frameSet, objects, oldState.tileIds);
+
+            auto a = std::make_unique<Action>(frameSet, std::move(objects),
+                                              std::move(oldState), std::move(newState));
+
+            auto undoDoc = dynamic_cast<UnTech::Undo::UndoDocument*>(&(frameSet->document()));
+            undoDoc->undoStack().add_undo(std::move(a));
+        }
+    }
+}
+
 void Selection::setFrameSet(MS::FrameSet* frameSet)
 {
     if (_frameSet != frameSet) {
@@ -426,3 +540,8 @@ void Selection::moveSelectedDown()
         break;
     }
 }
+
+void Selection::removeUnusedTiles()
+{
+    frameSet_removeUnusedTiles(_frameSet);
+}
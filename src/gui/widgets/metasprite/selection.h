@@ -66,6 +66,7 @@ public:
     bool canCrudSelected() const { return _type != Type::NONE; }
     bool canMoveSelectedUp() const;
     bool canMoveSelectedDown() const;
+    bool canRemoveUnusedTiles() const { return _frameSet != nullptr; }
 
     void createNewOfSelectedType();
     void cloneSelected();
@@ -73,6 +74,9 @@ public:
     void moveSelectedUp();
     void moveSelectedDown();
 
+    // Removes the tiles of the frameSet that are not used by any frame object.
+    void removeUnusedTiles();
+
     sigc::signal<void> signal_selectionChanged;
     sigc::signal<void> signal_frameSetChanged;
     sigc::signal<void> signal_paletteChanged;
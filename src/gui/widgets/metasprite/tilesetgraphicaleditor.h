@@ -2,6 +2,7 @@
 #define _UNTECH_GUI_WIDGETS_METASPRITE_TILESETGRAPHICALEDITOR_H_
 
 #include "selection.h"
+#include "models/common/imagescaler.h"
 
 #include <gtkmm.h>
 
@@ -54,6 +55,9 @@ private:
     /** A placeholder image to draw the tileset onto */
     UnTech::Image _tilesetImageBuffer;
 
+    /** Scales the tileset image, owns the data of _tilesetPixbuf. */
+    UnTech::ImageScaler _tilesetScaler;
+
     /** A pre-scaled copy of the tileset */
     Glib::RefPtr<Gdk::Pixbuf> _tilesetPixbuf;
 
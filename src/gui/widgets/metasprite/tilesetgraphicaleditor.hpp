@@ -191,6 +191,7 @@ TilesetGraphicalEditor<TilesetT>::TilesetGraphicalEditor(Selection& selection)
     , _zoomY(DEFAULT_ZOOM)
     , _displayZoom(NAN)
     , _tilesetImageBuffer()
+    , _tilesetScaler()
     , _tilesetPixbuf()
     , _drawTileState(false)
 {
@@ -297,15 +298,14 @@ void TilesetGraphicalEditor<TilesetT>::redrawTilesetPixbuf()
                        i, false, false);
         }
 
-        auto pixbuf = Gdk::Pixbuf::create_from_data(reinterpret_cast<const guint8*>(_tilesetImageBuffer.data()),
-                                                    Gdk::Colorspace::COLORSPACE_RGB, true, 8,
-                                                    width, height,
-                                                    width * 4);
+        // Scaling is done by ImageScaler not Cairo, as it results in sharp pixels
+        const Image& scaled = _tilesetScaler.scale(_tilesetImageBuffer,
+                                                   width * _zoomX, height * _zoomY);
 
-        // Scaling is done by GTK not Cairo, as it results in sharp pixels
-        _tilesetPixbuf = pixbuf->scale_simple(width * _zoomX,
-                                              height * _zoomY,
-                                              Gdk::InterpType::INTERP_NEAREST);
+        _tilesetPixbuf = Gdk::Pixbuf::create_from_data(reinterpret_cast<const guint8*>(scaled.data()),
+                                                       Gdk::Colorspace::COLORSPACE_RGB, true, 8,
+                                                       scaled.size().width, scaled.size().height,
+                                                       scaled.size().width * 4);
     }
     else {
         _tilesetPixbuf.reset();
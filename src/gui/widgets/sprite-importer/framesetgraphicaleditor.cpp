@@ -6,6 +6,7 @@
 #include "gui/widgets/common/cr_rgba.h"
 #include "gui/widgets/defaults.h"
 
+#include <algorithm>
 #include <cmath>
 
 using namespace UnTech::Widgets::SpriteImporter;
@@ -35,7 +36,7 @@ FrameSetGraphicalEditor::FrameSetGraphicalEditor(Selection& selection)
     , _zoomX(DEFAULT_ZOOM)
     , _zoomY(DEFAULT_ZOOM)
     , _displayZoom(NAN)
-    , _frameSetImage()
+    , _imageTiles()
     , _selection(selection)
 {
     set_hexpand(true);
@@ -56,7 +57,7 @@ FrameSetGraphicalEditor::FrameSetGraphicalEditor(Selection& selection)
     Signals::entityHitboxListChanged.connect(sigc::hide(sigc::mem_fun(this, &FrameSetGraphicalEditor::queue_draw)));
 
     _selection.signal_frameSetChanged.connect([this](void) {
-        loadAndScaleImage();
+        resetImageCache();
         resizeWidget();
     });
 
@@ -78,7 +79,7 @@ FrameSetGraphicalEditor::FrameSetGraphicalEditor(Selection& selection)
 
     Signals::frameSetImageChanged.connect([this](const SI::FrameSet* frameSet) {
         if (frameSet == _selection.frameSet()) {
-            loadAndScaleImage();
+            resetImageCache();
             resizeWidget();
         }
     });
@@ -132,36 +133,77 @@ void FrameSetGraphicalEditor::resizeWidget()
     queue_draw();
 }
 
-void FrameSetGraphicalEditor::loadAndScaleImage()
+void FrameSetGraphicalEditor::resetImageCache()
 {
-    if (_selection.frameSet()) {
-        const auto& img = _selection.frameSet()->image();
+    // The tiles are scaled when they are drawn
+    _imageTiles.clear();
 
-        if (!img.empty()) {
-            int width = img.size().width * _zoomX;
-            int height = img.size().height * _zoomY;
+    queue_draw();
+}
 
-            auto pixbuf = Gdk::Pixbuf::create_from_data(reinterpret_cast<const guint8*>(img.data()),
-                                                        Gdk::Colorspace::COLORSPACE_RGB, true, 8,
-                                                        img.size().width, img.size().height,
-                                                        img.size().width * 4);
+void FrameSetGraphicalEditor::drawImage(const Cairo::RefPtr<Cairo::Context>& cr)
+{
+    const double EMPTY_IMAGE_SIZE = 16;
+    const cr_rgba emptyImageColor = { 0.5, 0.5, 0.5, 0.5 };
 
-            // Scaling is done by GTK not Cairo, as it results in sharp pixels
-            _frameSetImage = pixbuf->scale_simple(width, height, Gdk::InterpType::INTERP_NEAREST);
-        }
-        else {
-            // show a gray tile
-            _frameSetImage = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, 16, 16);
-            _frameSetImage->fill(0x80808080);
-        }
+    const auto& img = _selection.frameSet()->image();
+
+    if (img.empty()) {
+        // show a gray tile
+        cr->rectangle(0, 0, EMPTY_IMAGE_SIZE, EMPTY_IMAGE_SIZE);
+        emptyImageColor.apply(cr);
+        cr->fill();
+        return;
     }
-    else {
-        // show an empty pixel
-        _frameSetImage = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, 1, 1);
-        _frameSetImage->fill(0);
+
+    const unsigned TILE_SIZE = UnTech::ScaledImageTileCache::TILE_SIZE;
+
+    const unsigned width = img.size().width * _zoomX;
+    const unsigned height = img.size().height * _zoomY;
+    const unsigned nColumns = (width + TILE_SIZE - 1) / TILE_SIZE;
+    const unsigned nRows = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    // Only the visible part of the widget is inside the clip area
+    double x1, y1, x2, y2;
+    cr->get_clip_extents(x1, y1, x2, y2);
+
+    const unsigned tx1 = std::max(0.0, std::floor(x1 / TILE_SIZE));
+    const unsigned ty1 = std::max(0.0, std::floor(y1 / TILE_SIZE));
+    const unsigned tx2 = std::min<double>(std::max(0.0, std::ceil(x2 / TILE_SIZE)), nColumns);
+    const unsigned ty2 = std::min<double>(std::max(0.0, std::ceil(y2 / TILE_SIZE)), nRows);
+
+    if (tx2 <= tx1 || ty2 <= ty1) {
+        return;
     }
 
-    queue_draw();
+    // The cache holds the visible tiles of two zoom levels, a smaller
+    // cache would evict the tiles within a single draw.
+    const unsigned nVisibleTiles = (tx2 - tx1) * (ty2 - ty1);
+
+    if (_imageTiles.maxTiles() < nVisibleTiles * 2) {
+        _imageTiles.setMaxTiles(nVisibleTiles * 2);
+    }
+
+    for (unsigned ty = ty1; ty < ty2; ty++) {
+        for (unsigned tx = tx1; tx < tx2; tx++) {
+            // Scaling is done by ImageScaler not Cairo, as it results in sharp pixels
+            const Image& tile = _imageTiles.tile(img, width, height, tx, ty);
+
+            if (tile.empty()) {
+                continue;
+            }
+
+            auto pixbuf = Gdk::Pixbuf::create_from_data(reinterpret_cast<const guint8*>(tile.data()),
+                                                        Gdk::Colorspace::COLORSPACE_RGB, true, 8,
+                                                        tile.size().width, tile.size().height,
+                                                        tile.size().width * 4);
+
+            // Only fill the tile, paint() would composite the whole clip area
+            Gdk::Cairo::set_source_pixbuf(cr, pixbuf, tx * TILE_SIZE, ty * TILE_SIZE);
+            cr->rectangle(tx * TILE_SIZE, ty * TILE_SIZE, tile.size().width, tile.size().height);
+            cr->fill();
+        }
+    }
 }
 
 bool FrameSetGraphicalEditor::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
@@ -211,8 +253,7 @@ bool FrameSetGraphicalEditor::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
     cr->set_antialias(Cairo::ANTIALIAS_NONE);
     cr->scale(_displayZoom, _displayZoom);
 
-    Gdk::Cairo::set_source_pixbuf(cr, _frameSetImage, 0, 0);
-    cr->paint();
+    drawImage(cr);
 
     if (_displayZoom > 1.0) {
         cr->set_antialias(Cairo::ANTIALIAS_DEFAULT);
@@ -940,7 +981,8 @@ void FrameSetGraphicalEditor::setZoom(double x, double y)
         _zoomX = limit(x, 1.0, 10.0);
         _zoomY = limit(y, 1.0, 10.0);
 
+        // The image tiles are cached per zoom level, the cache is not
+        // cleared so zooming back does not rescale the visible tiles.
         resizeWidget();
-        loadAndScaleImage();
     }
 }
@@ -3,6 +3,7 @@
 
 #include "selection.h"
 #include "models/sprite-importer.h"
+#include "models/common/scaledimagetilecache.h"
 
 #include <gtkmm.h>
 
@@ -43,7 +44,8 @@ protected:
     };
 
     void resizeWidget();
-    void loadAndScaleImage();
+    void resetImageCache();
+    void drawImage(const Cairo::RefPtr<Cairo::Context>& cr);
 
     bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr) override;
 
@@ -70,8 +72,9 @@ private:
      */
     double _displayZoom;
 
-    // A pre-scaled copy of the frameset image.
-    Glib::RefPtr<Gdk::Pixbuf> _frameSetImage;
+    // The pre-scaled tiles of the frameset image.
+    // Only the tiles in the visible area are scaled.
+    UnTech::ScaledImageTileCache _imageTiles;
 
     Selection& _selection;
     Action _action;
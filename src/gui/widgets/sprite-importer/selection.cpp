@@ -1,6 +1,7 @@
 #include "selection.h"
 #include "signals.h"
 #include "gui/undo/orderedlistactions.h"
+#include "models/sprite-importer/frameobjectcover.h"
 #include <glibmm/i18n.h>
 
 using namespace UnTech::Widgets::SpriteImporter;
@@ -417,3 +418,36 @@ void Selection::moveSelectedDown()
         break;
     }
 }
+
+void Selection::generateFrameObjects()
+{
+    if (_frame == nullptr) {
+        return;
+    }
+
+    // Prefer the tiles used by the other frames
+    SI::FrameObjectCover cover;
+    for (const auto frameIt : _frame->frameSet().frames()) {
+        if (&frameIt.second != _frame) {
+            cover.addFrameTiles(frameIt.second);
+        }
+    }
+
+    const auto objects = cover.process(*_frame);
+
+    if (_frameObject) {
+        setFrameObject(nullptr);
+    }
+
+    Undo::orderedList_replaceAll<SI::FrameObject>(
+        &_frame->objects(),
+        [&](SI::FrameObject::list_t& list) {
+            for (const auto& o : objects) {
+                SI::FrameObject& obj = list.create();
+                obj.setSize(o.size);
+                obj.setLocation(o.location);
+            }
+        },
+        Signals::frameObjectListChanged,
+        _("Generate Frame Objects"));
+}
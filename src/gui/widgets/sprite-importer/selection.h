@@ -50,6 +50,7 @@ public:
     bool canCrudSelected() const { return _type != Type::NONE; }
     bool canMoveSelectedUp() const;
     bool canMoveSelectedDown() const;
+    bool canGenerateFrameObjects() const { return _frame != nullptr; }
 
     void createNewOfSelectedType();
     void cloneSelected();
@@ -57,6 +58,10 @@ public:
     void moveSelectedUp();
     void moveSelectedDown();
 
+    // Replaces the frame's objects with an automatically generated set.
+    // Throws an exception if the frame is not inside the image.
+    void generateFrameObjects();
+
     sigc::signal<void> signal_selectionChanged;
     sigc::signal<void> signal_frameSetChanged;
     sigc::signal<void> signal_frameChanged;
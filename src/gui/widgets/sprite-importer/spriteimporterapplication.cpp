@@ -238,6 +238,12 @@ const Glib::ustring SpriteImporterApplication::_uiInfo
       "          <attribute name='action'>win.move-selected-down</attribute>"
       "        </item>"
       "      </section>"
+      "      <section>"
+      "        <item>"
+      "          <attribute name='label' translatable='yes'>_Generate Frame Objects</attribute>"
+      "          <attribute name='action'>win.generate-frame-objects</attribute>"
+      "        </item>"
+      "      </section>"
       "    </submenu>"
       "    <submenu>"
       "      <attribute name='label' translatable='yes'>_View</attribute>"
@@ -57,6 +57,11 @@ SpriteImporterWindow::SpriteImporterWindow()
         sigc::hide(sigc::mem_fun(_editor.selection(), &Selection::moveSelectedDown)));
     add_action(_moveSelectedDownAction);
 
+    _generateFrameObjectsAction = Gio::SimpleAction::create("generate-frame-objects");
+    _generateFrameObjectsAction->signal_activate().connect(
+        sigc::hide(sigc::mem_fun(*this, &SpriteImporterWindow::do_generateFrameObjects)));
+    add_action(_generateFrameObjectsAction);
+
     _zoomAction = add_action_radio_integer(
         "set-zoom", sigc::mem_fun(*this, &SpriteImporterWindow::do_setZoom), DEFAULT_ZOOM);
 
@@ -150,6 +155,7 @@ void SpriteImporterWindow::updateItemActions()
     _removeSelectedAction->set_enabled(canCrud);
     _moveSelectedUpAction->set_enabled(canMoveUp);
     _moveSelectedDownAction->set_enabled(canMoveDown);
+    _generateFrameObjectsAction->set_enabled(selection.canGenerateFrameObjects());
 }
 
 void SpriteImporterWindow::do_undo()
@@ -170,6 +176,16 @@ void SpriteImporterWindow::do_redo()
     }
 }
 
+void SpriteImporterWindow::do_generateFrameObjects()
+{
+    try {
+        _editor.selection().generateFrameObjects();
+    }
+    catch (const std::exception& ex) {
+        showErrorMessage(this, "Unable to generate frame objects", ex);
+    }
+}
+
 void SpriteImporterWindow::do_save()
 {
     auto* document = _editor.document();
@@ -32,6 +32,7 @@ protected:
 
     void do_undo();
     void do_redo();
+    void do_generateFrameObjects();
     void do_save();
     void do_saveAs();
 
@@ -52,6 +53,7 @@ private:
     Glib::RefPtr<Gio::SimpleAction> _removeSelectedAction;
     Glib::RefPtr<Gio::SimpleAction> _moveSelectedUpAction;
     Glib::RefPtr<Gio::SimpleAction> _moveSelectedDownAction;
+    Glib::RefPtr<Gio::SimpleAction> _generateFrameObjectsAction;
     Glib::RefPtr<Gio::SimpleAction> _zoomAction;
     Glib::RefPtr<Gio::SimpleAction> _aspectRatioAction;
 
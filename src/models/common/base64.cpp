@@ -1,10 +1,18 @@
 #include "base64.h"
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define UNTECH_BASE64_SIMD
+#endif
+
 using namespace UnTech;
 
-char lookup[64] = {
+namespace {
+
+const char lookup[64] = {
     'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
     'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
     'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
@@ -13,138 +21,493 @@ char lookup[64] = {
     '+', '/'
 };
 
-void Base64::encode(const std::vector<uint8_t>& data, std::ostream& file, unsigned indent)
+const unsigned CHARS_PER_LINE = 64;
+const unsigned BYTES_PER_LINE = CHARS_PER_LINE / 4 * 3;
+
+inline uint8_t get_val(const char& c)
 {
-    const unsigned CHARS_PER_LINE = 64;
-    const unsigned BLOCKS_PER_LINE = CHARS_PER_LINE / 4;
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    else if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    else if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    }
+    else if (c == '+' || c == '-') {
+        return 62;
+    }
+    else if (c == '/' || c == '_') {
+        return 63;
+    }
+    else {
+        return 0xFF;
+    }
+}
+
+// Encodes BYTES_PER_LINE bytes into CHARS_PER_LINE characters.
+// `in` MUST have 4 readable bytes after the line.
+typedef void (*EncodeLineFunction)(const uint8_t* in, char* out);
 
-    for (unsigned u = 0; u < indent; u++) {
-        file.put(' ');
+// Decodes blocks of valid base64 characters, stopping at the first block
+// that contains an invalid character (including whitespace and padding).
+// `out` MUST have room for `size * 3 / 4` bytes.
+// Returns the number of characters decoded (3/4 of which are written to out).
+typedef size_t (*DecodeBlocksFunction)(const char* in, size_t size, uint8_t* out);
+
+struct Implementation {
+    const char* name;
+    EncodeLineFunction encodeLine;
+    DecodeBlocksFunction decodeBlocks;
+};
+
+/*
+ * SCALAR
+ * ======
+ */
+
+inline void encodeGroupScalar(const uint8_t* in, char* out)
+{
+    out[0] = lookup[in[0] >> 2];
+    out[1] = lookup[((in[0] & 0x03) << 4) | (in[1] >> 4)];
+    out[2] = lookup[((in[1] & 0x0F) << 2) | (in[2] >> 6)];
+    out[3] = lookup[in[2] & 0x3F];
+}
+
+void encodeLineScalar(const uint8_t* in, char* out)
+{
+    for (unsigned i = 0; i < BYTES_PER_LINE; i += 3) {
+        encodeGroupScalar(in, out);
+        in += 3;
+        out += 4;
     }
+}
 
-    const uint8_t* ptr = data.data();
-    const uint8_t* endPtr = data.data() + data.size();
+size_t decodeBlocksScalar(const char*, size_t, uint8_t*)
+{
+    return 0;
+}
 
-    uint8_t tmp0, tmp1, tmp2, tmp3;
+const Implementation SCALAR_IMPLEMENTATION = {
+    "scalar",
+    encodeLineScalar,
+    decodeBlocksScalar,
+};
 
-    unsigned blocksOnLine = 0;
-    while (ptr < endPtr) {
-        {
-            tmp0 = *ptr >> 2;
-            tmp1 = (*ptr & 0x03) << 4;
+/*
+ * SSSE3 & AVX2
+ * ============
+ *
+ * Based on Wojciech Muła's base64 algorithms, which use pshufb as a
+ * 16 entry lookup table to translate between 6 bit values and ASCII.
+ *
+ * Encoding processes 12 bytes per 128 bit lane.
+ * Decoding processes 16 characters per 128 bit lane and validates the
+ * block using the high/low nibbles of each character.
+ *
+ * The URL-safe characters ('-' and '_') are decoded by the scalar code.
+ */
 
-            ptr++;
-        }
+#ifdef UNTECH_BASE64_SIMD
+
+__attribute__((target("ssse3"))) inline __m128i encodeBlockSsse3(__m128i in)
+{
+    // split 3 bytes into 4 x 6 bits values
+    in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
 
-        if (ptr < endPtr) {
-            tmp1 |= *ptr >> 4;
-            tmp2 = (*ptr & 0x0F) << 2;
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    const __m128i indices = _mm_or_si128(t1, t3);
+
+    // translate 6 bit values to ASCII
+    const __m128i shiftLut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                           '/' - 63, 'A', 0, 0);
+
+    __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+
+    return _mm_add_epi8(_mm_shuffle_epi8(shiftLut, result), indices);
+}
+
+// returns false if the block contains an invalid character
+__attribute__((target("ssse3"))) inline bool decodeBlockSsse3(__m128i in, __m128i& out)
+{
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                          0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2F = _mm_set1_epi8(0x2f);
 
-            ptr++;
+    const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask2F);
+    const __m128i loNibbles = _mm_and_si128(in, mask2F);
+    const __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+    const __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+
+    const __m128i invalid = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+    if (_mm_movemask_epi8(invalid) != 0xFFFF) {
+        return false;
+    }
+
+    const __m128i eq2F = _mm_cmpeq_epi8(in, mask2F);
+    const __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+    const __m128i values = _mm_add_epi8(in, roll);
+
+    // pack 4 x 6 bits into 3 bytes
+    const __m128i mergeAB = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    const __m128i merged = _mm_madd_epi16(mergeAB, _mm_set1_epi32(0x00011000));
+
+    out = _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    return true;
+}
+
+__attribute__((target("ssse3"))) void encodeLineSsse3(const uint8_t* in, char* out)
+{
+    for (unsigned i = 0; i < BYTES_PER_LINE; i += 12) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), encodeBlockSsse3(block));
+        out += 16;
+    }
+}
+
+__attribute__((target("ssse3"))) size_t decodeBlocksSsse3(const char* in, size_t size, uint8_t* out)
+{
+    size_t pos = 0;
+
+    // the 16 byte store writes 4 bytes past the decoded data
+    while (size - pos >= 32) {
+        __m128i decoded;
+        if (!decodeBlockSsse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + pos)), decoded)) {
+            break;
         }
-        else {
-            file.put(lookup[tmp0]);
-            file.put(lookup[tmp1]);
-            file.put('=');
-            file.put('=');
-            file.put('\n');
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), decoded);
+
+        pos += 16;
+        out += 12;
+    }
+
+    return pos;
+}
+
+const Implementation SSSE3_IMPLEMENTATION = {
+    "ssse3",
+    encodeLineSsse3,
+    decodeBlocksSsse3,
+};
+
+__attribute__((target("avx2"))) void encodeLineAvx2(const uint8_t* in, char* out)
+{
+    const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                             1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i shiftLut = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                              '/' - 63, 'A', 0, 0,
+                                              'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                              '/' - 63, 'A', 0, 0);
+
+    for (unsigned i = 0; i < BYTES_PER_LINE; i += 24) {
+        // 12 bytes in each lane
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12));
+        __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+        block = _mm256_shuffle_epi8(block, shuffle);
+
+        const __m256i t0 = _mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00));
+        const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        const __m256i t2 = _mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0));
+        const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(t1, t3);
+
+        __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        result = _mm256_add_epi8(_mm256_shuffle_epi8(shiftLut, result), indices);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), result);
+        out += 32;
+    }
+}
+
+__attribute__((target("avx2"))) size_t decodeBlocksAvx2(const char* in, size_t size, uint8_t* out)
+{
+    const __m256i lutLo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                           0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                           0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                           0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lutHi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                           0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                           0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                           0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lutRoll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                             0, 0, 0, 0, 0, 0, 0, 0,
+                                             0, 16, 19, 4, -65, -65, -71, -71,
+                                             0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask2F = _mm256_set1_epi8(0x2f);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    size_t pos = 0;
+
+    // the 32 byte store writes 8 bytes past the decoded data
+    while (size - pos >= 64) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + pos));
+
+        const __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(block, 4), mask2F);
+        const __m256i loNibbles = _mm256_and_si256(block, mask2F);
+        const __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+        const __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+
+        if (!_mm256_testz_si256(lo, hi)) {
             break;
         }
 
-        if (ptr < endPtr) {
-            tmp2 |= *ptr >> 6;
-            tmp3 = *ptr & 0x3F;
-
-            ptr++;
-
-            file.put(lookup[tmp0]);
-            file.put(lookup[tmp1]);
-            file.put(lookup[tmp2]);
-            file.put(lookup[tmp3]);
-
-            if (ptr < endPtr) {
-                blocksOnLine++;
-                if (blocksOnLine >= BLOCKS_PER_LINE) {
-                    file.put('\n');
-                    for (unsigned u = 0; u < indent; u++) {
-                        file.put(' ');
-                    }
-                    blocksOnLine = 0;
-                }
+        const __m256i eq2F = _mm256_cmpeq_epi8(block, mask2F);
+        const __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles));
+        const __m256i values = _mm256_add_epi8(block, roll);
+
+        const __m256i mergeAB = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        __m256i merged = _mm256_madd_epi16(mergeAB, _mm256_set1_epi32(0x00011000));
+
+        // 12 bytes in each lane, make them contiguous
+        merged = _mm256_shuffle_epi8(merged, pack);
+        merged = _mm256_permutevar8x32_epi32(merged, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), merged);
+
+        pos += 32;
+        out += 24;
+    }
+
+    // finish with 16 character blocks.
+    // zeroupper avoids the AVX to SSE transition penalty
+    _mm256_zeroupper();
+    return pos + decodeBlocksSsse3(in + pos, size - pos, out);
+}
+
+const Implementation AVX2_IMPLEMENTATION = {
+    "avx2",
+    encodeLineAvx2,
+    decodeBlocksAvx2,
+};
+
+#endif
+
+// The implementations supported by the CPU, fastest last.
+std::vector<const Implementation*> supportedImplementations()
+{
+    std::vector<const Implementation*> ret = { &SCALAR_IMPLEMENTATION };
+
+#ifdef UNTECH_BASE64_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        ret.push_back(&SSSE3_IMPLEMENTATION);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        ret.push_back(&AVX2_IMPLEMENTATION);
+    }
+#endif
+
+    return ret;
+}
+
+const std::vector<const Implementation*>& implementations()
+{
+    static const std::vector<const Implementation*> impls = supportedImplementations();
+    return impls;
+}
+
+const Implementation& implementation()
+{
+    static const Implementation& impl = *implementations().back();
+    return impl;
+}
+
+void encodeText(const Implementation& impl, const std::vector<uint8_t>& data,
+                std::ostream& file, unsigned indent)
+{
+    if (data.empty()) {
+        for (unsigned u = 0; u < indent; u++) {
+            file.put(' ');
+        }
+        return;
+    }
+
+    const EncodeLineFunction encodeLine = impl.encodeLine;
+
+    // The text is built in a buffer and written a block of lines at a time.
+    const unsigned LINES_PER_WRITE = 64;
+    const size_t lineSize = indent + CHARS_PER_LINE + 1;
+
+    std::string buffer(lineSize * LINES_PER_WRITE, ' ');
+
+    const uint8_t* ptr = data.data();
+    const uint8_t* endPtr = data.data() + data.size();
+
+    while (ptr < endPtr) {
+        char* out = &buffer[0];
+
+        for (unsigned l = 0; l < LINES_PER_WRITE && ptr < endPtr; l++) {
+            // buffer is filled with spaces, skip the indent
+            out += indent;
+
+            const size_t remaining = endPtr - ptr;
+
+            if (remaining >= BYTES_PER_LINE + 4) {
+                encodeLine(ptr, out);
+                ptr += BYTES_PER_LINE;
+                out += CHARS_PER_LINE;
             }
             else {
-                file.put('\n');
+                const uint8_t* lineEnd = ptr + std::min<size_t>(remaining, BYTES_PER_LINE);
+
+                while (lineEnd - ptr >= 3) {
+                    encodeGroupScalar(ptr, out);
+                    ptr += 3;
+                    out += 4;
+                }
+
+                if (lineEnd - ptr == 2) {
+                    uint8_t tmp[3] = { ptr[0], ptr[1], 0 };
+                    encodeGroupScalar(tmp, out);
+                    out[3] = '=';
+                    ptr += 2;
+                    out += 4;
+                }
+                else if (lineEnd - ptr == 1) {
+                    uint8_t tmp[3] = { ptr[0], 0, 0 };
+                    encodeGroupScalar(tmp, out);
+                    out[2] = '=';
+                    out[3] = '=';
+                    ptr += 1;
+                    out += 4;
+                }
+            }
+
+            *out++ = '\n';
+        }
+
+        file.write(buffer.data(), out - buffer.data());
+
+        // restore the indent
+        std::fill(buffer.begin(), buffer.end(), ' ');
+    }
+}
+
+// nTokens and tmp hold the state of a partially decoded group of 4 characters.
+size_t decodeText(const Implementation& impl, unsigned& nTokens, uint8_t& tmp,
+                  const char* text, size_t size, uint8_t* out)
+{
+    const DecodeBlocksFunction decodeBlocks = impl.decodeBlocks;
+
+    const char* ptr = text;
+    const char* ptrEnd = text + size;
+    uint8_t* outPtr = out;
+
+    while (ptr < ptrEnd) {
+        if (nTokens == 0) {
+            // Decodes the runs of valid characters between the whitespace.
+            size_t n = decodeBlocks(ptr, ptrEnd - ptr, outPtr);
+
+            ptr += n;
+            outPtr += n / 4 * 3;
+
+            if (ptr >= ptrEnd) {
                 break;
             }
         }
-        else {
-            file.put(lookup[tmp0]);
-            file.put(lookup[tmp1]);
-            file.put(lookup[tmp2]);
-            file.put('=');
-            file.put('\n');
+
+        uint8_t token = get_val(*ptr++);
+        if (token >= 64) {
+            continue;
+        }
+
+        switch (nTokens) {
+        case 0:
+            tmp = token << 2;
+            break;
+
+        case 1:
+            *outPtr++ = tmp | (token >> 4);
+            tmp = (token & 0x0F) << 4;
+            break;
+
+        case 2:
+            *outPtr++ = tmp | (token >> 2);
+            tmp = (token & 0x03) << 6;
+            break;
+
+        case 3:
+            *outPtr++ = tmp | token;
             break;
         }
+
+        nTokens = (nTokens + 1) & 3;
     }
+
+    return outPtr - out;
+}
 }
 
-inline uint8_t get_val(const char& c)
+void Base64::encode(const std::vector<uint8_t>& data, std::ostream& file, unsigned indent)
 {
-    if (c >= 'A' && c <= 'Z') {
-        return c - 'A';
-    }
-    else if (c >= 'a' && c <= 'z') {
-        return c - 'a' + 26;
-    }
-    else if (c >= '0' && c <= '9') {
-        return c - '0' + 52;
-    }
-    else if (c == '+' || c == '-') {
-        return 62;
-    }
-    else if (c == '/' || c == '_') {
-        return 63;
-    }
-    else {
-        return 0xFF;
-    }
+    encodeText(implementation(), data, file, indent);
 }
 
 std::vector<uint8_t> Base64::decode(const std::string& text)
 {
-    std::vector<uint8_t> out;
+    std::vector<uint8_t> out(Decoder::maxDecodedSize(text.size()));
 
-    uint8_t token, tmp;
+    Decoder decoder;
+    size_t size = decoder.decode(text.data(), text.size(), out.data());
 
-    const char* ptr = text.c_str();
-    const char* ptrEnd = text.c_str() + text.size();
+    out.resize(size);
+    return out;
+}
 
-#define NEXT_TOKEN()                              \
-    if (ptr < ptrEnd) {                           \
-        while ((token = get_val(*ptr++)) >= 64) { \
-            if (ptr >= ptrEnd) {                  \
-                return out;                       \
-            }                                     \
-        }                                         \
-    }                                             \
-    else {                                        \
-        return out;                               \
-    }
+size_t Base64::Decoder::decode(const char* text, size_t size, uint8_t* out)
+{
+    return decodeText(implementation(), _nTokens, _tmp, text, size, out);
+}
 
-    while (ptr < ptrEnd) {
-        NEXT_TOKEN()
-        tmp = token << 2;
+const char* Base64::implementationName()
+{
+    return implementation().name;
+}
 
-        NEXT_TOKEN()
-        out.push_back(tmp | (token >> 4));
-        tmp = (token & 0x0F) << 4;
+unsigned Base64::nImplementations()
+{
+    return implementations().size();
+}
 
-        NEXT_TOKEN()
-        out.push_back(tmp | (token >> 2));
-        tmp = (token & 0x03) << 6;
+const char* Base64::implementationName(unsigned implementation)
+{
+    return implementations().at(implementation)->name;
+}
 
-        NEXT_TOKEN()
-        out.push_back(tmp | token);
-    }
+void Base64::encodeWith(unsigned implementation, const std::vector<uint8_t>& data,
+                        std::ostream& file, unsigned indent)
+{
+    encodeText(*implementations().at(implementation), data, file, indent);
+}
+
+std::vector<uint8_t> Base64::decodeWith(unsigned implementation, const std::string& text)
+{
+    std::vector<uint8_t> out(Decoder::maxDecodedSize(text.size()));
+
+    unsigned nTokens = 0;
+    uint8_t tmp = 0;
+    size_t size = decodeText(*implementations().at(implementation), nTokens, tmp,
+                             text.data(), text.size(), out.data());
+
+    out.resize(size);
     return out;
 }
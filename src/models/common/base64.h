@@ -1,6 +1,7 @@
 #ifndef _UNTECH_MODELS_COMMON_BASE64_H_
 #define _UNTECH_MODELS_COMMON_BASE64_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -8,6 +9,11 @@
 namespace UnTech {
 namespace Base64 {
 
+/*
+ * The encoder and decoder are vectorized, the implementation
+ * (AVX2, SSSE3 or scalar) is selected at runtime.
+ */
+
 /**
  * Encodes the given data as base64 text in the given file.
  * Uses MIME base64 style, indented by `indent` spaces.
@@ -20,6 +26,61 @@ void encode(const std::vector<uint8_t>& data, std::ostream& file, unsigned inden
  * All invalid characters are skipped.
  */
 std::vector<uint8_t> decode(const std::string& text);
+
+/**
+ * A streaming base64 decoder.
+ *
+ * All invalid characters are skipped, so the text can be split
+ * at any position.
+ */
+class Decoder {
+public:
+    Decoder()
+        : _nTokens(0)
+        , _tmp(0)
+    {
+    }
+
+    /** The maximum number of bytes `decode` will output for `size` characters */
+    constexpr static size_t maxDecodedSize(size_t size) { return size * 3 / 4 + 1; }
+
+    /**
+     * Decodes `size` characters of text into out.
+     *
+     * out MUST have room for `maxDecodedSize(size)` bytes.
+     *
+     * returns the number of bytes written to out.
+     */
+    size_t decode(const char* text, size_t size, uint8_t* out);
+
+private:
+    unsigned _nTokens;
+    uint8_t _tmp;
+};
+
+/** Returns the name of the selected implementation */
+const char* implementationName();
+
+/*
+ * The implementations supported by the CPU can also be called directly,
+ * for comparing them in tests.
+ *
+ * Implementation 0 is the scalar implementation, the last one is the
+ * selected implementation.
+ */
+
+/** Returns the number of implementations supported by the CPU */
+unsigned nImplementations();
+
+/** Returns the name of the given implementation */
+const char* implementationName(unsigned implementation);
+
+/** `encode` using the given implementation */
+void encodeWith(unsigned implementation, const std::vector<uint8_t>& data,
+                std::ostream& file, unsigned indent = 0);
+
+/** `decode` using the given implementation */
+std::vector<uint8_t> decodeWith(unsigned implementation, const std::string& text);
 }
 }
 #endif
@@ -1,9 +1,12 @@
 #include "file.h"
 #include "string.h"
+#include <cstdint>
 #include <cstdio>
 #include <string>
 #include <fstream>
+#include <iterator>
 #include <stdexcept>
+#include <vector>
 
 // ::TODO compile in windows::
 
@@ -18,6 +21,12 @@
 #include <unistd.h>
 #endif
 
+#ifndef PLATFORM_WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #ifdef PLATFORM_WINDOWS
 // This is the only module that requires windows character conversion
 
@@ -81,6 +90,170 @@ std::string File::readUtf8TextFile(const std::string& filename)
     throw std::runtime_error("Cannot open file");
 }
 
+namespace {
+
+std::vector<uint8_t> readBinaryFile(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open file");
+    }
+
+    std::vector<uint8_t> ret((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    if (in.bad()) {
+        throw std::runtime_error("Cannot read file");
+    }
+
+    return ret;
+}
+}
+
+#ifdef PLATFORM_WINDOWS
+// ::TODO memory map in windows::
+
+File::MemoryMappedUtf8TextFile::MemoryMappedUtf8TextFile(const std::string& filename)
+    : _mapping(nullptr)
+    , _mappingSize(0)
+    , _buffer(readUtf8TextFile(filename))
+    , _data(_buffer.c_str())
+    , _size(_buffer.size())
+{
+}
+
+File::MemoryMappedUtf8TextFile::~MemoryMappedUtf8TextFile() = default;
+
+File::MemoryMappedFile::MemoryMappedFile(const std::string& filename)
+    : _mapping(nullptr)
+    , _mappingSize(0)
+    , _buffer(readBinaryFile(filename))
+    , _data(_buffer.data())
+    , _size(_buffer.size())
+{
+}
+
+File::MemoryMappedFile::~MemoryMappedFile() = default;
+
+#else
+
+File::MemoryMappedUtf8TextFile::MemoryMappedUtf8TextFile(const std::string& filename)
+    : _mapping(nullptr)
+    , _mappingSize(0)
+    , _buffer()
+    , _data(nullptr)
+    , _size(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file");
+    }
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0 || !S_ISREG(statbuf.st_mode)) {
+        close(fd);
+
+        _buffer = readUtf8TextFile(filename);
+        _data = _buffer.c_str();
+        _size = _buffer.size();
+        return;
+    }
+
+    const size_t fileSize = statbuf.st_size;
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+
+    // The file is mapped over a zeroed anonymous mapping that is at least
+    // one byte larger than the file, so the text is always NUL terminated.
+    _mappingSize = (fileSize / pageSize + 1) * pageSize;
+
+    _mapping = mmap(nullptr, _mappingSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (_mapping == MAP_FAILED) {
+        _mapping = nullptr;
+        close(fd);
+        throw std::runtime_error("Cannot map file");
+    }
+
+    if (fileSize > 0) {
+        void* m = mmap(_mapping, fileSize, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        if (m == MAP_FAILED) {
+            munmap(_mapping, _mappingSize);
+            _mapping = nullptr;
+            close(fd);
+            throw std::runtime_error("Cannot map file");
+        }
+        madvise(_mapping, fileSize, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(_mapping);
+    size_t offset = 0;
+
+    // check for BOM
+    if (fileSize > 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) {
+        offset = 3;
+    }
+
+    _data = static_cast<const char*>(_mapping) + offset;
+    _size = fileSize - offset;
+
+    if (!String::checkUtf8WellFormed(_data, _size)) {
+        munmap(_mapping, _mappingSize);
+        _mapping = nullptr;
+        throw std::runtime_error("File is not UTF-8 Well Formed");
+    }
+}
+
+File::MemoryMappedUtf8TextFile::~MemoryMappedUtf8TextFile()
+{
+    if (_mapping) {
+        munmap(_mapping, _mappingSize);
+    }
+}
+
+File::MemoryMappedFile::MemoryMappedFile(const std::string& filename)
+    : _mapping(nullptr)
+    , _mappingSize(0)
+    , _buffer()
+    , _data(nullptr)
+    , _size(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file");
+    }
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0 || !S_ISREG(statbuf.st_mode) || statbuf.st_size == 0) {
+        close(fd);
+
+        _buffer = readBinaryFile(filename);
+        _data = _buffer.data();
+        _size = _buffer.size();
+        return;
+    }
+
+    _mappingSize = statbuf.st_size;
+
+    _mapping = mmap(nullptr, _mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (_mapping == MAP_FAILED) {
+        _mapping = nullptr;
+        throw std::runtime_error("Cannot map file");
+    }
+
+    _data = static_cast<const uint8_t*>(_mapping);
+    _size = _mappingSize;
+}
+
+File::MemoryMappedFile::~MemoryMappedFile()
+{
+    if (_mapping) {
+        munmap(_mapping, _mappingSize);
+    }
+}
+
+#endif
+
 std::pair<std::string, std::string> File::splitFilename(const std::string& filename)
 {
     if (filename.empty()) {
@@ -150,7 +323,7 @@ std::string File::cleanPath(const std::string& path)
     char ret[path.length() + 1];
 
     char* pos = ret;
-    char* dirs[path.length() / 2];
+    char* dirs[path.length() + 1];
     size_t nDirs = 0;
 
     while (*source != 0) {
@@ -206,7 +379,12 @@ std::string File::cleanPath(const std::string& path)
 #endif
     }
 
-    return std::string(ret);
+    // The terminator is not copied if the path ends in a separator
+    if (pos > ret && pos[-1] == 0) {
+        pos--;
+    }
+
+    return std::string(ret, pos);
 }
 
 std::string File::joinPath(const std::string& dir, const std::string& path)
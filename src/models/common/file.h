@@ -1,8 +1,11 @@
 #ifndef _UNTECH_MODELS_COMMON_FILE_H_
 #define _UNTECH_MODELS_COMMON_FILE_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace UnTech {
 namespace File {
@@ -18,6 +21,73 @@ namespace File {
  */
 std::string readUtf8TextFile(const std::string& filename);
 
+/**
+ * A read-only memory mapped UTF-8 text file.
+ *
+ * If the file has a UTF-8 BOM it will be skipped.
+ *
+ * The constructor checks that the file is well formed and
+ * `data()` is always followed by a NUL byte.
+ *
+ * Non-regular files are read into memory instead.
+ *
+ * NOTE: Truncating the file while it is mapped is undefined behaviour.
+ *
+ * Raises an exception if an error occurred.
+ */
+class MemoryMappedUtf8TextFile {
+public:
+    MemoryMappedUtf8TextFile() = delete;
+    MemoryMappedUtf8TextFile(const MemoryMappedUtf8TextFile&) = delete;
+    MemoryMappedUtf8TextFile& operator=(const MemoryMappedUtf8TextFile&) = delete;
+
+    explicit MemoryMappedUtf8TextFile(const std::string& filename);
+    ~MemoryMappedUtf8TextFile();
+
+    inline const char* data() const { return _data; }
+    inline size_t size() const { return _size; }
+    inline bool empty() const { return _size == 0; }
+
+private:
+    void* _mapping;
+    size_t _mappingSize;
+    std::string _buffer;
+
+    const char* _data;
+    size_t _size;
+};
+
+/**
+ * A read-only memory mapped binary file.
+ *
+ * Non-regular files are read into memory instead.
+ *
+ * NOTE: Truncating the file while it is mapped is undefined behaviour.
+ *
+ * Raises an exception if an error occurred.
+ */
+class MemoryMappedFile {
+public:
+    MemoryMappedFile() = delete;
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+    explicit MemoryMappedFile(const std::string& filename);
+    ~MemoryMappedFile();
+
+    inline const uint8_t* data() const { return _data; }
+    inline size_t size() const { return _size; }
+    inline bool empty() const { return _size == 0; }
+
+private:
+    void* _mapping;
+    size_t _mappingSize;
+    std::vector<uint8_t> _buffer;
+
+    const uint8_t* _data;
+    size_t _size;
+};
+
 /**
  * Splits a filename into its dir, pathname components.
  *
@@ -59,3 +59,18 @@ bool Image::loadPngImage(const std::string& filename)
 
     return true;
 }
+
+bool Image::savePngImage(const std::string& filename)
+{
+    auto error = lodepng::encode(filename, _imageData, _size.width, _size.height);
+
+    if (error) {
+        std::stringstream msg;
+        msg << filename << ": " << lodepng_error_text(error);
+        _errorString = msg.str();
+
+        return false;
+    }
+
+    return true;
+}
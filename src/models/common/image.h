@@ -19,6 +19,8 @@ public:
     Image(unsigned width, unsigned height);
 
     Image(const Image&) = delete;
+    Image(Image&&) = default;
+    Image& operator=(Image&&) = default;
 
     ~Image() = default;
 
@@ -41,6 +43,15 @@ public:
      */
     bool loadPngImage(const std::string& filename);
 
+    /**
+     * Saves the image to a PNG file.
+     *
+     * If the image cannot be saved then:
+     *   - return false
+     *   _ errorString is set.
+     */
+    bool savePngImage(const std::string& filename);
+
     /**
      * Returns true if the image is empty.
      */
@@ -0,0 +1,174 @@
+#include "imagescaler.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace UnTech;
+
+namespace UnTech {
+namespace ImageScalerPrivate {
+
+inline void buildMap(std::vector<unsigned>& map, unsigned srcSize, unsigned destSize,
+                     unsigned start, unsigned count)
+{
+    map.resize(count);
+
+    for (unsigned i = 0; i < count; i++) {
+        const uint64_t s = (uint64_t(start + i) * 2 + 1) * srcSize / (uint64_t(destSize) * 2);
+        map[i] = std::min<unsigned>(s, srcSize - 1);
+    }
+}
+
+// Writes `zoom` copies of each of the `count` pixels in `src` to `dest`.
+inline void replicatePixels(rgba* dest, const rgba* src, unsigned count, unsigned zoom)
+{
+#ifdef __SSE2__
+    if (zoom == 2) {
+        unsigned i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i* d = reinterpret_cast<__m128i*>(dest + i * 2);
+
+            _mm_storeu_si128(d, _mm_unpacklo_epi32(v, v));
+            _mm_storeu_si128(d + 1, _mm_unpackhi_epi32(v, v));
+        }
+        for (; i < count; i++) {
+            dest[i * 2] = src[i];
+            dest[i * 2 + 1] = src[i];
+        }
+        return;
+    }
+
+    if (zoom >= 4) {
+        // the last store of each pixel overlaps the previous one
+        // if zoom is not a multiple of 4.
+        for (unsigned i = 0; i < count; i++) {
+            const __m128i v = _mm_set1_epi32(src[i].value);
+            rgba* d = dest + i * zoom;
+
+            for (unsigned x = 0; x + 4 < zoom; x += 4) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x), v);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + zoom - 4), v);
+        }
+        return;
+    }
+
+    if (zoom == 3 && count > 0) {
+        // each store writes one pixel past the end of the copies, it is
+        // overridden by the next pixel.
+        for (unsigned i = 0; i < count - 1; i++) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 3), _mm_set1_epi32(src[i].value));
+        }
+        std::fill_n(dest + (count - 1) * 3, 3, src[count - 1]);
+        return;
+    }
+#endif
+
+    for (unsigned i = 0; i < count; i++) {
+        std::fill_n(dest + i * zoom, zoom, src[i]);
+    }
+}
+}
+}
+
+using namespace UnTech::ImageScalerPrivate;
+
+const Image& ImageScaler::scale(const Image& src, unsigned width, unsigned height, urect destArea)
+{
+    destArea.x = std::min(destArea.x, width);
+    destArea.y = std::min(destArea.y, height);
+    destArea.width = std::min(destArea.width, width - destArea.x);
+    destArea.height = std::min(destArea.height, height - destArea.y);
+
+    if (_image.size().width != destArea.width || _image.size().height != destArea.height) {
+        _image = Image(destArea.width, destArea.height);
+    }
+
+    _srcSize = src.size();
+    _destPos = upoint(destArea.x, destArea.y);
+
+    if (src.empty() || _image.empty()) {
+        _columns.clear();
+        _rows.clear();
+        _xZoom = 0;
+        return _image;
+    }
+
+    buildMap(_columns, _srcSize.width, width, destArea.x, destArea.width);
+    buildMap(_rows, _srcSize.height, height, destArea.y, destArea.height);
+
+    _xZoom = width % _srcSize.width == 0 ? width / _srcSize.width : 0;
+
+    scaleRows(src, 0, destArea.width, 0, destArea.height);
+
+    return _image;
+}
+
+urect ImageScaler::scaleArea(const Image& src, const urect& area)
+{
+    if (_columns.empty() || _rows.empty()
+        || src.size().width != _srcSize.width || src.size().height != _srcSize.height) {
+        return urect(0, 0, 0, 0);
+    }
+
+    // The maps are sorted, find the destination pixels that sample the area.
+    const unsigned xStart = std::lower_bound(_columns.begin(), _columns.end(), area.left()) - _columns.begin();
+    const unsigned xEnd = std::lower_bound(_columns.begin(), _columns.end(), area.right()) - _columns.begin();
+    const unsigned yStart = std::lower_bound(_rows.begin(), _rows.end(), area.top()) - _rows.begin();
+    const unsigned yEnd = std::lower_bound(_rows.begin(), _rows.end(), area.bottom()) - _rows.begin();
+
+    if (xStart >= xEnd || yStart >= yEnd) {
+        return urect(0, 0, 0, 0);
+    }
+
+    scaleRows(src, xStart, xEnd, yStart, yEnd);
+
+    return urect(xStart, yStart, xEnd - xStart, yEnd - yStart);
+}
+
+void ImageScaler::scaleRows(const Image& src, unsigned xStart, unsigned xEnd,
+                            unsigned yStart, unsigned yEnd)
+{
+    const unsigned width = xEnd - xStart;
+
+    // With an integer zoom the columns between the first and last
+    // whole source pixel are replicated, the rest use the column map.
+    unsigned repStart = xEnd;
+    unsigned repCount = 0;
+    if (_xZoom != 0) {
+        const unsigned head = (_xZoom - (_destPos.x + xStart) % _xZoom) % _xZoom;
+
+        if (head < width) {
+            repStart = xStart + head;
+            repCount = (width - head) / _xZoom;
+        }
+    }
+    const unsigned repEnd = repStart + repCount * _xZoom;
+
+    for (unsigned y = yStart; y < yEnd; y++) {
+        rgba* dest = _image.scanline(y);
+
+        if (y > yStart && _rows[y] == _rows[y - 1]) {
+            memcpy(dest + xStart, _image.scanline(y - 1) + xStart, width * sizeof(rgba));
+            continue;
+        }
+
+        const rgba* srcRow = src.scanline(_rows[y]);
+
+        for (unsigned x = xStart; x < repStart; x++) {
+            dest[x] = srcRow[_columns[x]];
+        }
+
+        if (repCount > 0) {
+            replicatePixels(dest + repStart, srcRow + _columns[repStart], repCount, _xZoom);
+        }
+
+        for (unsigned x = repEnd; x < xEnd; x++) {
+            dest[x] = srcRow[_columns[x]];
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef _UNTECH_MODELS_COMMON_IMAGESCALER_H_
+#define _UNTECH_MODELS_COMMON_IMAGESCALER_H_
+
+#include "aabb.h"
+#include "image.h"
+#include <vector>
+
+namespace UnTech {
+
+/**
+ * A nearest neighbour image scaler, used by the GUI editors to zoom images.
+ *
+ * The scaled image is kept in a buffer that is reused until the output
+ * size changes.
+ *
+ * Destination pixel `x` samples source pixel
+ * `floor((x + 0.5) * srcWidth / width)`. Integer horizontal zooms
+ * replicate the pixels with SSE2 and each output row that samples the
+ * same source row is copied from the previous one.
+ */
+class ImageScaler {
+public:
+    ImageScaler() = default;
+    ImageScaler(const ImageScaler&) = delete;
+
+    /**
+     * Scales `src` to `width` x `height` pixels.
+     *
+     * Returns the scaled image, which is valid until the next call to scale.
+     */
+    const Image& scale(const Image& src, unsigned width, unsigned height)
+    {
+        return scale(src, width, height, urect(0, 0, width, height));
+    }
+
+    /**
+     * Scales `src` to `width` x `height` pixels, only the `destArea` of
+     * the scaled image is stored.
+     *
+     * `destArea` is clipped to the scaled image.
+     *
+     * Returns the `destArea` of the scaled image, which is valid until
+     * the next call to scale.
+     */
+    const Image& scale(const Image& src, unsigned width, unsigned height, urect destArea);
+
+    /**
+     * Rescales the `area` (in source pixels) of `src`.
+     *
+     * `src` MUST be the same size as the image given to the last
+     * scale call.
+     *
+     * Returns the area of the stored image that was changed.
+     */
+    urect scaleArea(const Image& src, const urect& area);
+
+    const Image& image() const { return _image; }
+
+private:
+    void scaleRows(const Image& src, unsigned xStart, unsigned xEnd,
+                   unsigned yStart, unsigned yEnd);
+
+private:
+    Image _image;
+    usize _srcSize;
+
+    // The position of _image within the scaled image.
+    upoint _destPos;
+
+    // The source column/row of each column/row of _image.
+    std::vector<unsigned> _columns;
+    std::vector<unsigned> _rows;
+
+    // 0 if the horizontal zoom is not an integer.
+    unsigned _xZoom = 0;
+};
+}
+
+#endif
@@ -21,6 +21,9 @@ class OrderedListAddRemove;
  *      * std::find is done on the pointer level.
  *      * undo engine can remove and insert in place.
  *
+ * The list has a revision number that changes whenever an item is added,
+ * removed or moved, it can be used to invalidate caches of the list.
+ *
  * MEMORY: The owner (parent) class MUST exist when while the list exists.
  * THREADS: NOT THREAD SAFE
  */
@@ -57,12 +60,14 @@ public:
     T& create()
     {
         _list.emplace_back(std::make_unique<T>(_owner));
+        _revision++;
         return *(_list.back());
     }
 
     T& clone(const T& e)
     {
         _list.emplace_back(std::make_unique<T>(e, _owner));
+        _revision++;
         return *(_list.back());
     }
 
@@ -72,6 +77,7 @@ public:
 
         if (it != _list.end()) {
             _list.erase(it);
+            _revision++;
         }
     }
 
@@ -84,6 +90,7 @@ public:
                 auto other = it - 1;
 
                 iter_swap(it, other);
+                _revision++;
                 return true;
             }
         }
@@ -99,6 +106,7 @@ public:
 
             if (other != _list.end()) {
                 iter_swap(it, other);
+                _revision++;
                 return true;
             }
         }
@@ -140,6 +148,8 @@ public:
 
     inline size_t size() const { return _list.size(); }
 
+    inline unsigned revision() const { return _revision; }
+
     inline iterator begin() noexcept { return _list.begin(); }
     inline iterator end() noexcept { return _list.end(); }
     inline const_iterator begin() const noexcept { return _list.begin(); }
@@ -173,6 +183,7 @@ protected:
             std::unique_ptr<T> ret = std::move(*it);
 
             _list.erase(it);
+            _revision++;
 
             return std::move(ret);
         }
@@ -185,11 +196,13 @@ protected:
     {
         auto it = _list.begin() + index;
         _list.insert(it, std::move(e));
+        _revision++;
     }
 
 private:
     P& _owner;
     std::vector<std::unique_ptr<T>> _list;
+    unsigned _revision = 0;
 };
 }
 
@@ -0,0 +1,47 @@
+#ifndef _UNTECH_MODELS_COMMON_PARALLELFOR_H_
+#define _UNTECH_MODELS_COMMON_PARALLELFOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace UnTech {
+
+/**
+ * Calls `func(i)` for every i in [0, count) using up to nThreads threads.
+ *
+ * The indexes are handed out in order, one at a time, to the first
+ * free thread. The calling thread is one of the workers.
+ *
+ * `func` MUST NOT throw.
+ */
+template <class Func>
+void parallelFor(size_t count, unsigned nThreads, const Func& func)
+{
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next++) < count) {
+            func(i);
+        }
+    };
+
+    if (nThreads > count) {
+        nThreads = count;
+    }
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < nThreads; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include "scaledimagetilecache.h"
+#include <algorithm>
+#include <iterator>
+
+using namespace UnTech;
+
+ScaledImageTileCache::ScaledImageTileCache(unsigned maxTiles)
+    : _maxTiles(std::max(1U, maxTiles))
+    , _tiles()
+    , _index()
+{
+}
+
+const Image& ScaledImageTileCache::tile(const Image& src, unsigned width, unsigned height,
+                                        unsigned tileX, unsigned tileY)
+{
+    const key_t key(width, height, tileX, tileY);
+
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+        _tiles.splice(_tiles.begin(), _tiles, it->second);
+        return it->second->scaler.image();
+    }
+
+    if (_tiles.size() >= _maxTiles) {
+        // reuse the least recently used tile, and its buffer
+        _index.erase(_tiles.back().key);
+        _tiles.splice(_tiles.begin(), _tiles, std::prev(_tiles.end()));
+    }
+    else {
+        _tiles.emplace_front();
+    }
+
+    Tile& t = _tiles.front();
+    t.key = key;
+    _index.emplace(key, _tiles.begin());
+
+    const urect area(tileX * TILE_SIZE, tileY * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+    return t.scaler.scale(src, width, height, area);
+}
+
+void ScaledImageTileCache::setMaxTiles(unsigned maxTiles)
+{
+    _maxTiles = std::max(1U, maxTiles);
+
+    while (_tiles.size() > _maxTiles) {
+        _index.erase(_tiles.back().key);
+        _tiles.pop_back();
+    }
+}
+
+void ScaledImageTileCache::clear()
+{
+    _index.clear();
+    _tiles.clear();
+}
@@ -0,0 +1,76 @@
+#ifndef _UNTECH_MODELS_COMMON_SCALEDIMAGETILECACHE_H_
+#define _UNTECH_MODELS_COMMON_SCALEDIMAGETILECACHE_H_
+
+#include "aabb.h"
+#include "image.h"
+#include "imagescaler.h"
+#include <list>
+#include <map>
+#include <tuple>
+
+namespace UnTech {
+
+/**
+ * A least recently used cache of the tiles of a scaled image.
+ *
+ * Used to display large images at high zoom levels, only the visible
+ * tiles are scaled and at most `maxTiles` tiles are kept in memory.
+ * `maxTiles` MUST be larger than the number of tiles drawn at once,
+ * otherwise the tiles are evicted before they are reused.
+ *
+ * The tiles of multiple zoom levels can be stored in the cache.
+ *
+ * The cache does not know when the source image changes, `clear` MUST be
+ * called when it does.
+ */
+class ScaledImageTileCache {
+public:
+    // The size of a tile in scaled pixels
+    const static unsigned TILE_SIZE = 256;
+
+    // 16 MiB of 256x256 tiles
+    const static unsigned DEFAULT_MAX_TILES = 64;
+
+public:
+    ScaledImageTileCache(unsigned maxTiles = DEFAULT_MAX_TILES);
+    ScaledImageTileCache(const ScaledImageTileCache&) = delete;
+
+    /**
+     * Returns the tile at (tileX * TILE_SIZE, tileY * TILE_SIZE) of `src`
+     * scaled to `width` x `height` pixels.
+     *
+     * The tiles on the right and bottom edges are smaller than TILE_SIZE.
+     *
+     * The returned image is valid until the next call to tile or clear.
+     */
+    const Image& tile(const Image& src, unsigned width, unsigned height,
+                      unsigned tileX, unsigned tileY);
+
+    // Removes all the tiles from the cache
+    void clear();
+
+    // Changes the size of the cache, evicting the least recently used
+    // tiles if necessary.
+    void setMaxTiles(unsigned maxTiles);
+
+    unsigned maxTiles() const { return _maxTiles; }
+    size_t size() const { return _tiles.size(); }
+
+private:
+    // width, height, tileX, tileY
+    typedef std::tuple<unsigned, unsigned, unsigned, unsigned> key_t;
+
+    struct Tile {
+        key_t key;
+        ImageScaler scaler;
+    };
+
+    unsigned _maxTiles;
+
+    // most recently used first
+    std::list<Tile> _tiles;
+    std::map<key_t, std::list<Tile>::iterator> _index;
+};
+}
+
+#endif
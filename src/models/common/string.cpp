@@ -6,10 +6,15 @@ using namespace UnTech;
 
 bool String::checkUtf8WellFormed(const std::string& str)
 {
-    const unsigned char* c = (const unsigned char*)str.c_str();
+    return checkUtf8WellFormed(str.c_str(), str.size());
+}
+
+bool String::checkUtf8WellFormed(const char* str, size_t size)
+{
+    const unsigned char* c = (const unsigned char*)str;
     size_t length = 0;
 
-    if (str.empty()) {
+    if (size == 0) {
         return true;
     }
 
@@ -76,5 +81,5 @@ bool String::checkUtf8WellFormed(const std::string& str)
         }
     }
 
-    return length == str.size();
+    return length == size;
 }
@@ -14,6 +14,12 @@ namespace String {
  */
 bool checkUtf8WellFormed(const std::string& str);
 
+/**
+ * @return true if the first `size` bytes of str are utf8 well formed
+ *         and str[size] is NULL.
+ */
+bool checkUtf8WellFormed(const char* str, size_t size);
+
 static inline std::string& ltrim(std::string& s)
 {
     size_t f = s.find_first_not_of(" \t\n\r", 0, 4);
@@ -18,6 +18,25 @@ inline bool isWhitespace(char c)
     return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
 }
 
+// Returns the length of the escape sequence at `pos`, or 1 if there is
+// no escape sequence.
+inline size_t xmlEscapeSequenceLength(const char* pos, const char* end)
+{
+    const char* s = pos + 1;
+    const size_t remaining = end - s;
+
+    if (remaining >= 3 && (memcmp(s, "lt;", 3) == 0 || memcmp(s, "gt;", 3) == 0)) {
+        return 4;
+    }
+    else if (remaining >= 4 && memcmp(s, "amp;", 4) == 0) {
+        return 5;
+    }
+    else if (remaining >= 5 && (memcmp(s, "apos;", 5) == 0 || memcmp(s, "quot;", 5) == 0)) {
+        return 6;
+    }
+    return 1;
+}
+
 inline std::string unescapeXmlString(const char* start, const char* end)
 {
     std::string ret;
@@ -117,6 +136,8 @@ using namespace UnTech::XmlPrivate;
 
 XmlReader::XmlReader(const std::string& xml, const std::string& filename)
     : _inputString(xml)
+    , _inputFile()
+    , _input(_inputString.c_str())
     , _filename(filename)
 {
     if (xml.empty()) {
@@ -128,15 +149,30 @@ XmlReader::XmlReader(const std::string& xml, const std::string& filename)
     parseDocument();
 }
 
+XmlReader::XmlReader(std::unique_ptr<File::MemoryMappedUtf8TextFile> file, const std::string& filename)
+    : _inputString()
+    , _inputFile(std::move(file))
+    , _input(_inputFile->data())
+    , _filename(filename)
+{
+    if (_inputFile->empty()) {
+        throw std::runtime_error("Empty XML file");
+    }
+
+    std::tie(_dirname, _filepart) = File::splitFilename(filename);
+
+    parseDocument();
+}
+
 std::unique_ptr<XmlReader> XmlReader::fromFile(const std::string& filename)
 {
-    std::string xml = File::readUtf8TextFile(filename);
-    return std::make_unique<XmlReader>(xml, filename);
+    auto file = std::make_unique<File::MemoryMappedUtf8TextFile>(filename);
+    return std::make_unique<XmlReader>(std::move(file), filename);
 }
 
 void XmlReader::parseDocument()
 {
-    _pos = _inputString.c_str();
+    _pos = _input;
     _tagStack = std::stack<std::string>();
     _inSelfClosingTag = false;
     _lineNo = 1;
@@ -262,21 +298,16 @@ std::unique_ptr<XmlTag> XmlReader::parseTag()
     throw buildXmlParseError(this, tagName, "Incomplete tag");
 }
 
-std::string XmlReader::parseText()
+template <class TextFunc, class CDataFunc>
+inline void XmlReader::parseTextSegments(const TextFunc& textFunc, const CDataFunc& cdataFunc)
 {
-    if (_inSelfClosingTag) {
-        return std::string();
-    }
-
-    std::string text;
-
     const char* startText = _pos;
     while (*_pos) {
         if (memcmp(_pos, "<!--", 4) == 0) {
-            text += unescapeXmlString(startText, _pos);
+            textFunc(startText, _pos);
 
             // skip comment
-            while (memcmp(_pos, "-->", 4) != 0) {
+            while (memcmp(_pos, "-->", 3) != 0) {
                 if (*_pos == 0) {
                     throw buildXmlParseError(this, "Unclosed comment");
                 }
@@ -290,7 +321,7 @@ std::string XmlReader::parseText()
         }
 
         else if (memcmp(_pos, "<![CDATA[", 9) == 0) {
-            text += unescapeXmlString(startText, _pos);
+            textFunc(startText, _pos);
 
             _pos += 9;
             const char* startCData = _pos;
@@ -304,7 +335,7 @@ std::string XmlReader::parseText()
                 }
                 _pos++;
             }
-            text.append(startCData, _pos - startCData);
+            cdataFunc(startCData, _pos);
 
             _pos += 3;
             startText = _pos;
@@ -322,14 +353,82 @@ std::string XmlReader::parseText()
         }
     }
 
-    text += unescapeXmlString(startText, _pos);
+    textFunc(startText, _pos);
+}
+
+std::string XmlReader::parseText()
+{
+    if (_inSelfClosingTag) {
+        return std::string();
+    }
+
+    std::string text;
+
+    parseTextSegments(
+        [&](const char* start, const char* end) {
+            text += unescapeXmlString(start, end);
+        },
+        [&](const char* start, const char* end) {
+            text.append(start, end - start);
+        });
 
     return text;
 }
 
 std::vector<uint8_t> XmlReader::parseBase64()
 {
-    return Base64::decode(parseText());
+    std::vector<uint8_t> data;
+
+    parseBase64([&](const uint8_t* decoded, size_t size) {
+        data.insert(data.end(), decoded, decoded + size);
+    });
+
+    return data;
+}
+
+size_t XmlReader::parseBase64(const std::function<void(const uint8_t*, size_t)>& callback)
+{
+    if (_inSelfClosingTag) {
+        return 0;
+    }
+
+    const size_t CHUNK_SIZE = 4096;
+    uint8_t buffer[Base64::Decoder::maxDecodedSize(CHUNK_SIZE)];
+
+    Base64::Decoder decoder;
+    size_t totalSize = 0;
+
+    auto decode = [&](const char* start, const char* end) {
+        while (start < end) {
+            const size_t s = std::min<size_t>(end - start, CHUNK_SIZE);
+            const size_t n = decoder.decode(start, s, buffer);
+
+            if (n > 0) {
+                callback(buffer, n);
+                totalSize += n;
+            }
+            start += s;
+        }
+    };
+
+    parseTextSegments(
+        [&](const char* start, const char* end) {
+            // The escape sequences do not decode to base64 characters
+            // and are skipped.
+            const char* pos = start;
+            while (pos < end) {
+                const char* amp = static_cast<const char*>(memchr(pos, '&', end - pos));
+                if (amp == nullptr) {
+                    break;
+                }
+                decode(pos, amp);
+                pos = amp + xmlEscapeSequenceLength(amp, end);
+            }
+            decode(pos, end);
+        },
+        decode);
+
+    return totalSize;
 }
 
 void XmlReader::parseCloseTag()
@@ -388,7 +487,7 @@ void XmlReader::skipText()
     while (*_pos) {
         if (memcmp(_pos, "<!--", 4) == 0) {
             // skip comment
-            while (memcmp(_pos, "-->", 4) != 0) {
+            while (memcmp(_pos, "-->", 3) != 0) {
                 if (*_pos == 0) {
                     throw buildXmlParseError(this, "Unclosed comment");
                 }
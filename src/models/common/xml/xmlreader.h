@@ -3,8 +3,10 @@
 
 #include "xml.h"
 #include "../aabb.h"
+#include "../file.h"
 #include "../string.h"
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <stack>
 #include <string>
@@ -37,6 +39,9 @@ class XmlReader {
 public:
     XmlReader(const std::string& xml, const std::string& filename = "");
 
+    /** Parses the memory mapped file in place, without copying it. */
+    XmlReader(std::unique_ptr<File::MemoryMappedUtf8TextFile> file, const std::string& filename);
+
     static std::unique_ptr<XmlReader> fromFile(const std::string& filename);
 
     /** restart processing from the beginning */
@@ -57,6 +62,15 @@ public:
     /** returns the base64 data at the current cursor */
     std::vector<uint8_t> parseBase64();
 
+    /**
+     * Decodes the base64 data at the current cursor without copying the text.
+     *
+     * The decoded data is passed to callback in blocks of (up to) 3 KiB.
+     *
+     * returns the number of bytes decoded.
+     */
+    size_t parseBase64(const std::function<void(const uint8_t*, size_t)>& callback);
+
     /** This method will skip over any child/sibling text/tags in order to close the current tag */
     void parseCloseTag();
 
@@ -96,8 +110,15 @@ private:
     std::string parseName();
     std::string parseAttributeValue();
 
+    // Calls textFunc(start, end) for each escaped text segment and
+    // cdataFunc(start, end) for each CDATA section at the cursor.
+    template <class TextFunc, class CDataFunc>
+    void parseTextSegments(const TextFunc& textFunc, const CDataFunc& cdataFunc);
+
 private:
     const std::string _inputString;
+    const std::unique_ptr<File::MemoryMappedUtf8TextFile> _inputFile;
+    const char* const _input;
     const char* _pos;
     std::stack<std::string> _tagStack;
     bool _inSelfClosingTag;
@@ -0,0 +1,190 @@
+#include "binaryformat.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+using namespace UnTech;
+using namespace UnTech::MetaSprite::Binary;
+
+BinaryFile::BinaryFile(const std::string& filename)
+    : _filename(filename)
+    , _file(std::make_unique<File::MemoryMappedFile>(filename))
+    , _names(nullptr)
+    , _namesSize(0)
+    , _smallTileset(nullptr)
+    , _nSmallTiles(0)
+    , _largeTileset(nullptr)
+    , _nLargeTiles(0)
+    , _palettes(nullptr)
+    , _nPalettes(0)
+    , _frames(nullptr)
+    , _nFrames(0)
+    , _objects(nullptr)
+    , _nObjects(0)
+    , _actionPoints(nullptr)
+    , _nActionPoints(0)
+    , _entityHitboxes(nullptr)
+    , _nEntityHitboxes(0)
+{
+    const uint8_t* data = _file->data();
+    const size_t size = _file->size();
+
+    if (!isBinaryData(data, size)) {
+        throw buildError("Not a binary metasprite file");
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(data);
+
+    if (header->versionMajor != VERSION_MAJOR) {
+        throw buildError("Unsupported binary metasprite version");
+    }
+    if (header->headerSize < sizeof(Header) || header->sectionEntrySize < sizeof(SectionEntry)
+        || header->headerSize % alignof(SectionEntry) != 0
+        || header->sectionEntrySize % alignof(SectionEntry) != 0) {
+        throw buildError("Invalid header");
+    }
+    if (header->fileSize != size) {
+        throw buildError("File size mismatch");
+    }
+    if (header->headerSize > size
+        || header->nSections > (size - header->headerSize) / header->sectionEntrySize) {
+        throw buildError("Invalid section table");
+    }
+
+    validateSections();
+
+    // Names
+
+    _names = reinterpret_cast<const char*>(findSection("NAME", 1, _namesSize));
+    if (_names == nullptr || _namesSize == 0 || _names[_namesSize - 1] != '\0') {
+        throw buildError("Invalid NAME section");
+    }
+
+    // Tilesets and palettes
+
+    _smallTileset = findSection("STIL", SMALL_TILE_SIZE, _nSmallTiles);
+    _largeTileset = findSection("LTIL", LARGE_TILE_SIZE, _nLargeTiles);
+    _palettes = findSection("PALT", PALETTE_SIZE, _nPalettes);
+
+    // Frames
+
+    _frames = reinterpret_cast<const FrameRecord*>(findSection("FRAM", sizeof(FrameRecord), _nFrames));
+    _objects = reinterpret_cast<const ObjectRecord*>(findSection("OBJS", sizeof(ObjectRecord), _nObjects));
+    _actionPoints = reinterpret_cast<const ActionPointRecord*>(findSection("APTS", sizeof(ActionPointRecord), _nActionPoints));
+    _entityHitboxes = reinterpret_cast<const EntityHitboxRecord*>(findSection("EHBX", sizeof(EntityHitboxRecord), _nEntityHitboxes));
+
+    for (size_t i = 0; i < _nFrames; i++) {
+        const FrameRecord& f = _frames[i];
+
+        if (f.nameOffset >= _namesSize
+            || size_t(f.firstObject) + f.nObjects > _nObjects
+            || size_t(f.firstActionPoint) + f.nActionPoints > _nActionPoints
+            || size_t(f.firstEntityHitbox) + f.nEntityHitboxes > _nEntityHitboxes) {
+
+            throw buildError("Invalid frame record");
+        }
+
+        if (i > 0 && strcmp(frameName(_frames[i - 1]), frameName(f)) >= 0) {
+            throw buildError("Frames are not sorted");
+        }
+    }
+
+    for (size_t i = 0; i < _nObjects; i++) {
+        const ObjectRecord& o = _objects[i];
+
+        if (o.tileId >= (o.large() ? _nLargeTiles : _nSmallTiles)) {
+            throw buildError("Invalid object tile id");
+        }
+    }
+}
+
+bool BinaryFile::isBinaryData(const uint8_t* data, size_t size)
+{
+    return size >= sizeof(Header) && memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void BinaryFile::validateSections() const
+{
+    const uint8_t* data = _file->data();
+    const size_t size = _file->size();
+    const Header* header = reinterpret_cast<const Header*>(data);
+
+    const size_t tableEnd = header->headerSize + size_t(header->nSections) * header->sectionEntrySize;
+
+    std::vector<std::pair<size_t, size_t>> ranges;
+    ranges.reserve(header->nSections);
+
+    for (unsigned i = 0; i < header->nSections; i++) {
+        const SectionEntry* s = reinterpret_cast<const SectionEntry*>(
+            data + header->headerSize + i * header->sectionEntrySize);
+
+        if (s->offset > size || s->size > size - s->offset) {
+            throw buildError("Section out of range");
+        }
+
+        if (s->size > 0) {
+            if (s->offset < tableEnd) {
+                throw buildError("Section overlaps the section table");
+            }
+            ranges.emplace_back(s->offset, s->offset + s->size);
+        }
+    }
+
+    std::sort(ranges.begin(), ranges.end());
+    for (size_t i = 1; i < ranges.size(); i++) {
+        if (ranges[i].first < ranges[i - 1].second) {
+            throw buildError("Overlapping sections");
+        }
+    }
+}
+
+const uint8_t* BinaryFile::findSection(const char* id, size_t recordSize, size_t& count) const
+{
+    const uint8_t* data = _file->data();
+    const Header* header = reinterpret_cast<const Header*>(data);
+
+    for (unsigned i = 0; i < header->nSections; i++) {
+        const SectionEntry* s = reinterpret_cast<const SectionEntry*>(
+            data + header->headerSize + i * header->sectionEntrySize);
+
+        if (memcmp(s->id, id, sizeof(s->id)) != 0) {
+            continue;
+        }
+
+        if (s->offset % SECTION_ALIGNMENT != 0
+            || s->offset > _file->size()
+            || s->size > _file->size() - s->offset
+            || s->size != uint64_t(s->count) * recordSize) {
+
+            throw buildError("Invalid section");
+        }
+
+        count = s->count;
+        return count > 0 ? data + s->offset : nullptr;
+    }
+
+    count = 0;
+    return nullptr;
+}
+
+const FrameRecord* BinaryFile::findFrame(const std::string& name) const
+{
+    const FrameRecord* end = _frames + _nFrames;
+
+    const FrameRecord* it = std::lower_bound(
+        _frames, end, name,
+        [this](const FrameRecord& f, const std::string& n) {
+            return n.compare(frameName(f)) > 0;
+        });
+
+    if (it != end && name == frameName(*it)) {
+        return it;
+    }
+    return nullptr;
+}
+
+std::runtime_error BinaryFile::buildError(const char* message) const
+{
+    return std::runtime_error(_filename + ": " + message);
+}
@@ -0,0 +1,220 @@
+#ifndef _UNTECH_MODELS_METASPRITE_BINARYFORMAT_H
+#define _UNTECH_MODELS_METASPRITE_BINARYFORMAT_H
+
+#include "../common/file.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#error "The binary metasprite format is little endian"
+#endif
+
+namespace UnTech {
+namespace MetaSprite {
+
+/**
+ * The binary metasprite (.utmb) container.
+ *
+ * A machine-to-machine alternative to the XML serializer, the file is
+ * designed to be memory mapped and used in place.
+ *
+ * All values are little endian and every record is naturally aligned.
+ *
+ *      Header
+ *      SectionEntry[header.nSections]
+ *      sections (each starting on an 8 byte boundary)
+ *
+ * Sections are identified by a four character id. Readers MUST ignore
+ * unknown sections, so new sections can be added without bumping
+ * the major version.
+ *
+ * The sections are:
+ *      NAME: NUL terminated UTF-8 strings, the frameset name is at offset 0.
+ *            count is the size of the string table in bytes.
+ *      STIL: small tileset, 32 bytes per tile in SNES 4bpp planar format.
+ *      LTIL: large tileset, 128 bytes per tile (4 8px tiles,
+ *            top-left, top-right, bottom-left, bottom-right).
+ *      PALT: palettes, 32 bytes per palette in SNES BGR555 format.
+ *      FRAM: FrameRecord, sorted by name.
+ *      OBJS: ObjectRecord, grouped by frame.
+ *      APTS: ActionPointRecord, grouped by frame.
+ *      EHBX: EntityHitboxRecord, grouped by frame.
+ */
+namespace Binary {
+
+const static char MAGIC[8] = { 'U', 'T', 'M', 'S', 'B', 'I', 'N', 0x1A };
+
+const static uint16_t VERSION_MAJOR = 1;
+const static uint16_t VERSION_MINOR = 0;
+
+const static unsigned SECTION_ALIGNMENT = 8;
+
+struct Header {
+    char magic[8];
+    uint16_t versionMajor;
+    uint16_t versionMinor;
+    uint16_t headerSize;
+    uint16_t sectionEntrySize;
+    uint32_t nSections;
+    uint32_t fileSize;
+    uint32_t reserved[2];
+};
+static_assert(sizeof(Header) == 32, "Bad Header size");
+
+struct SectionEntry {
+    char id[4];
+    uint32_t offset;
+    uint32_t size;
+    uint32_t count;
+};
+static_assert(sizeof(SectionEntry) == 16, "Bad SectionEntry size");
+
+struct FrameRecord {
+    const static uint8_t SOLID_FLAG = 0x01;
+
+    uint32_t nameOffset;
+    uint32_t firstObject;
+    uint32_t firstActionPoint;
+    uint32_t firstEntityHitbox;
+    uint16_t nObjects;
+    uint16_t nActionPoints;
+    uint16_t nEntityHitboxes;
+    uint8_t flags;
+    uint8_t reserved;
+    int8_t tileHitboxX;
+    int8_t tileHitboxY;
+    uint8_t tileHitboxWidth;
+    uint8_t tileHitboxHeight;
+
+    inline bool solid() const { return flags & SOLID_FLAG; }
+};
+static_assert(sizeof(FrameRecord) == 28, "Bad FrameRecord size");
+
+struct ObjectRecord {
+    const static uint8_t LARGE_FLAG = 0x01;
+    const static uint8_t HFLIP_FLAG = 0x40;
+    const static uint8_t VFLIP_FLAG = 0x80;
+
+    int8_t x;
+    int8_t y;
+    uint8_t flags;
+    uint8_t order;
+    uint16_t tileId;
+    uint16_t reserved;
+
+    inline bool large() const { return flags & LARGE_FLAG; }
+    inline bool hFlip() const { return flags & HFLIP_FLAG; }
+    inline bool vFlip() const { return flags & VFLIP_FLAG; }
+};
+static_assert(sizeof(ObjectRecord) == 8, "Bad ObjectRecord size");
+
+struct ActionPointRecord {
+    int8_t x;
+    int8_t y;
+    uint8_t parameter;
+    uint8_t reserved;
+};
+static_assert(sizeof(ActionPointRecord) == 4, "Bad ActionPointRecord size");
+
+struct EntityHitboxRecord {
+    int8_t x;
+    int8_t y;
+    uint8_t width;
+    uint8_t height;
+    uint8_t parameter;
+    uint8_t reserved[3];
+};
+static_assert(sizeof(EntityHitboxRecord) == 8, "Bad EntityHitboxRecord size");
+
+const static size_t SMALL_TILE_SIZE = 32;
+const static size_t LARGE_TILE_SIZE = 128;
+const static size_t PALETTE_SIZE = 32;
+
+/**
+ * A read-only view of a memory mapped binary metasprite file.
+ *
+ * The constructor validates the header, the section table (bounds and
+ * overlaps), the bounds of the frame records and the object tile ids.
+ * The data is never copied.
+ *
+ * Raises an exception if the file is invalid.
+ */
+class BinaryFile {
+public:
+    BinaryFile() = delete;
+    BinaryFile(const BinaryFile&) = delete;
+    BinaryFile& operator=(const BinaryFile&) = delete;
+
+    explicit BinaryFile(const std::string& filename);
+
+    /** Checks if the data starts with the binary metasprite magic */
+    static bool isBinaryData(const uint8_t* data, size_t size);
+
+    inline const char* frameSetName() const { return _names; }
+
+    inline size_t nSmallTiles() const { return _nSmallTiles; }
+    inline const uint8_t* smallTilesetData() const { return _smallTileset; }
+
+    inline size_t nLargeTiles() const { return _nLargeTiles; }
+    inline const uint8_t* largeTilesetData() const { return _largeTileset; }
+
+    inline size_t nPalettes() const { return _nPalettes; }
+    inline const uint8_t* paletteData(size_t i) const { return _palettes + i * PALETTE_SIZE; }
+
+    inline size_t nFrames() const { return _nFrames; }
+    inline const FrameRecord& frame(size_t i) const { return _frames[i]; }
+
+    inline const char* frameName(const FrameRecord& f) const { return _names + f.nameOffset; }
+
+    inline const ObjectRecord* objects(const FrameRecord& f) const { return _objects + f.firstObject; }
+    inline const ActionPointRecord* actionPoints(const FrameRecord& f) const { return _actionPoints + f.firstActionPoint; }
+    inline const EntityHitboxRecord* entityHitboxes(const FrameRecord& f) const { return _entityHitboxes + f.firstEntityHitbox; }
+
+    /** Binary searches the frames by name, returns nullptr if not found */
+    const FrameRecord* findFrame(const std::string& name) const;
+
+private:
+    // checks every section is inside the file and no two sections overlap
+    void validateSections() const;
+
+    // returns nullptr (and count 0) if the section does not exist
+    const uint8_t* findSection(const char* id, size_t recordSize, size_t& count) const;
+
+    std::runtime_error buildError(const char* message) const;
+
+private:
+    const std::string _filename;
+    std::unique_ptr<File::MemoryMappedFile> _file;
+
+    const char* _names;
+    size_t _namesSize;
+
+    const uint8_t* _smallTileset;
+    size_t _nSmallTiles;
+
+    const uint8_t* _largeTileset;
+    size_t _nLargeTiles;
+
+    const uint8_t* _palettes;
+    size_t _nPalettes;
+
+    const FrameRecord* _frames;
+    size_t _nFrames;
+
+    const ObjectRecord* _objects;
+    size_t _nObjects;
+
+    const ActionPointRecord* _actionPoints;
+    size_t _nActionPoints;
+
+    const EntityHitboxRecord* _entityHitboxes;
+    size_t _nEntityHitboxes;
+};
+}
+}
+}
+
+#endif
@@ -0,0 +1,341 @@
+#include "binaryserializer.h"
+#include "binaryformat.h"
+#include "frameset.h"
+#include "frame.h"
+#include "actionpoint.h"
+#include "entityhitbox.h"
+#include "frameobject.h"
+#include "palette.h"
+#include "../common/atomicofstream.h"
+#include "../common/namechecks.h"
+#include "../snes/palette.hpp"
+#include "../snes/tileset.hpp"
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+using namespace UnTech;
+using namespace UnTech::MetaSprite;
+using namespace UnTech::MetaSprite::Binary;
+
+namespace UnTech {
+namespace MetaSprite {
+namespace BinarySerializer {
+
+/*
+ * FRAME SET READER
+ * ================
+ */
+
+namespace FrameSetReader {
+
+inline void readFrame(Frame& frame, const BinaryFile& file, const FrameRecord& record)
+{
+    const ObjectRecord* objects = file.objects(record);
+    for (unsigned i = 0; i < record.nObjects; i++) {
+        const ObjectRecord& o = objects[i];
+        FrameObject& obj = frame.objects().create();
+
+        obj.setSize(o.large() ? FrameObject::ObjectSize::LARGE : FrameObject::ObjectSize::SMALL);
+        obj.setLocation(ms8point(o.x, o.y));
+        obj.setTileId(o.tileId);
+        obj.setOrder(o.order);
+        obj.setHFlip(o.hFlip());
+        obj.setVFlip(o.vFlip());
+    }
+
+    const ActionPointRecord* actionPoints = file.actionPoints(record);
+    for (unsigned i = 0; i < record.nActionPoints; i++) {
+        const ActionPointRecord& a = actionPoints[i];
+        ActionPoint& ap = frame.actionPoints().create();
+
+        ap.setLocation(ms8point(a.x, a.y));
+        ap.setParameter(a.parameter);
+    }
+
+    const EntityHitboxRecord* entityHitboxes = file.entityHitboxes(record);
+    for (unsigned i = 0; i < record.nEntityHitboxes; i++) {
+        const EntityHitboxRecord& e = entityHitboxes[i];
+        EntityHitbox& eh = frame.entityHitboxes().create();
+
+        eh.setAabb(ms8rect(e.x, e.y, e.width, e.height));
+        eh.setParameter(e.parameter);
+    }
+
+    frame.setSolid(record.solid());
+    if (record.solid()) {
+        frame.setTileHitbox(ms8rect(record.tileHitboxX, record.tileHitboxY,
+                                    record.tileHitboxWidth, record.tileHitboxHeight));
+    }
+}
+
+inline void readFrameSet(FrameSet& frameSet, const BinaryFile& file)
+{
+    assert(frameSet.frames().size() == 0);
+
+    if (!isNameValid(file.frameSetName())) {
+        throw std::runtime_error(std::string("Invalid frameset name: ") + file.frameSetName());
+    }
+    frameSet.setName(file.frameSetName());
+
+    frameSet.smallTileset().readSnesData(file.smallTilesetData(), file.nSmallTiles() * SMALL_TILE_SIZE);
+    frameSet.largeTileset().readSnesData(file.largeTilesetData(), file.nLargeTiles() * LARGE_TILE_SIZE);
+
+    for (size_t i = 0; i < file.nPalettes(); i++) {
+        const uint8_t* data = file.paletteData(i);
+
+        Palette& palette = frameSet.palettes().create();
+        palette.readPalette(std::vector<uint8_t>(data, data + PALETTE_SIZE));
+    }
+
+    for (size_t i = 0; i < file.nFrames(); i++) {
+        const FrameRecord& record = file.frame(i);
+
+        Frame* frame = frameSet.frames().create(file.frameName(record));
+        if (frame == nullptr) {
+            throw std::runtime_error(std::string("Invalid frame name: ") + file.frameName(record));
+        }
+
+        readFrame(*frame, file, record);
+    }
+}
+}
+
+/*
+ * FRAME SET WRITER
+ * ================
+ */
+
+struct FrameSetWriter {
+    std::vector<char> names;
+    std::vector<uint8_t> smallTileset;
+    std::vector<uint8_t> largeTileset;
+    std::vector<uint8_t> palettes;
+    std::vector<FrameRecord> frames;
+    std::vector<ObjectRecord> objects;
+    std::vector<ActionPointRecord> actionPoints;
+    std::vector<EntityHitboxRecord> entityHitboxes;
+
+    template <class T>
+    static inline T checkRange(size_t value, const char* what)
+    {
+        if (value > std::numeric_limits<T>::max()) {
+            throw std::runtime_error(std::string("Too many ") + what + " for the binary format");
+        }
+        return value;
+    }
+
+    inline uint32_t addName(const std::string& name)
+    {
+        uint32_t offset = checkRange<uint32_t>(names.size(), "names");
+
+        names.insert(names.end(), name.begin(), name.end());
+        names.push_back('\0');
+
+        return offset;
+    }
+
+    inline void addFrame(const std::string& frameName, const Frame& frame)
+    {
+        FrameRecord record;
+        memset(&record, 0, sizeof(record));
+
+        record.nameOffset = addName(frameName);
+
+        record.firstObject = checkRange<uint32_t>(objects.size(), "objects");
+        record.nObjects = checkRange<uint16_t>(frame.objects().size(), "objects");
+
+        for (const FrameObject& obj : frame.objects()) {
+            ObjectRecord o;
+            memset(&o, 0, sizeof(o));
+
+            o.x = obj.location().x;
+            o.y = obj.location().y;
+            o.flags = (obj.size() == FrameObject::ObjectSize::LARGE ? ObjectRecord::LARGE_FLAG : 0)
+                      | (obj.hFlip() ? ObjectRecord::HFLIP_FLAG : 0)
+                      | (obj.vFlip() ? ObjectRecord::VFLIP_FLAG : 0);
+            o.order = obj.order();
+            o.tileId = checkRange<uint16_t>(obj.tileId(), "tiles");
+
+            objects.push_back(o);
+        }
+
+        record.firstActionPoint = checkRange<uint32_t>(actionPoints.size(), "action points");
+        record.nActionPoints = checkRange<uint16_t>(frame.actionPoints().size(), "action points");
+
+        for (const ActionPoint& ap : frame.actionPoints()) {
+            ActionPointRecord a;
+            memset(&a, 0, sizeof(a));
+
+            a.x = ap.location().x;
+            a.y = ap.location().y;
+            a.parameter = ap.parameter();
+
+            actionPoints.push_back(a);
+        }
+
+        record.firstEntityHitbox = checkRange<uint32_t>(entityHitboxes.size(), "entity hitboxes");
+        record.nEntityHitboxes = checkRange<uint16_t>(frame.entityHitboxes().size(), "entity hitboxes");
+
+        for (const EntityHitbox& eh : frame.entityHitboxes()) {
+            EntityHitboxRecord e;
+            memset(&e, 0, sizeof(e));
+
+            const ms8rect aabb = eh.aabb();
+            e.x = aabb.x;
+            e.y = aabb.y;
+            e.width = aabb.width;
+            e.height = aabb.height;
+            e.parameter = eh.parameter();
+
+            entityHitboxes.push_back(e);
+        }
+
+        if (frame.solid()) {
+            const ms8rect th = frame.tileHitbox();
+
+            record.flags |= FrameRecord::SOLID_FLAG;
+            record.tileHitboxX = th.x;
+            record.tileHitboxY = th.y;
+            record.tileHitboxWidth = th.width;
+            record.tileHitboxHeight = th.height;
+        }
+
+        frames.push_back(record);
+    }
+
+    inline void addFrameSet(const FrameSet& frameSet)
+    {
+        addName(frameSet.name());
+
+        smallTileset = frameSet.smallTileset().snesData();
+        largeTileset = frameSet.largeTileset().snesData();
+
+        for (const Palette& p : frameSet.palettes()) {
+            const auto data = p.paletteData();
+            palettes.insert(palettes.end(), data.begin(), data.end());
+        }
+
+        // NamedList is sorted by name
+        for (const auto fIt : frameSet.frames()) {
+            addFrame(fIt.first, fIt.second);
+        }
+    }
+
+    struct Section {
+        const char* id;
+        const void* data;
+        size_t size;
+        size_t count;
+    };
+
+    template <class T>
+    static inline Section section(const char* id, const std::vector<T>& v, size_t recordSize = sizeof(T))
+    {
+        return { id, v.data(), v.size() * sizeof(T), v.size() * sizeof(T) / recordSize };
+    }
+
+    void write(std::ostream& file) const
+    {
+        const Section sections[] = {
+            section("NAME", names),
+            section("STIL", smallTileset, SMALL_TILE_SIZE),
+            section("LTIL", largeTileset, LARGE_TILE_SIZE),
+            section("PALT", palettes, PALETTE_SIZE),
+            section("FRAM", frames),
+            section("OBJS", objects),
+            section("APTS", actionPoints),
+            section("EHBX", entityHitboxes),
+        };
+        const unsigned N_SECTIONS = sizeof(sections) / sizeof(Section);
+
+        auto align = [](size_t offset) {
+            return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+        };
+
+        SectionEntry entries[N_SECTIONS];
+        memset(entries, 0, sizeof(entries));
+
+        size_t offset = align(sizeof(Header) + sizeof(entries));
+        for (unsigned i = 0; i < N_SECTIONS; i++) {
+            const Section& s = sections[i];
+
+            memcpy(entries[i].id, s.id, sizeof(entries[i].id));
+            entries[i].offset = checkRange<uint32_t>(offset, "bytes");
+            entries[i].size = checkRange<uint32_t>(s.size, "bytes");
+            entries[i].count = checkRange<uint32_t>(s.count, "records");
+
+            offset = align(offset + s.size);
+        }
+
+        Header header;
+        memset(&header, 0, sizeof(header));
+
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.versionMajor = VERSION_MAJOR;
+        header.versionMinor = VERSION_MINOR;
+        header.headerSize = sizeof(Header);
+        header.sectionEntrySize = sizeof(SectionEntry);
+        header.nSections = N_SECTIONS;
+        header.fileSize = checkRange<uint32_t>(offset, "bytes");
+
+        const char padding[SECTION_ALIGNMENT] = {};
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(entries), sizeof(entries));
+
+        size_t pos = sizeof(Header) + sizeof(entries);
+        for (unsigned i = 0; i < N_SECTIONS; i++) {
+            file.write(padding, entries[i].offset - pos);
+            file.write(static_cast<const char*>(sections[i].data), sections[i].size);
+
+            pos = entries[i].offset + sections[i].size;
+        }
+        file.write(padding, header.fileSize - pos);
+    }
+};
+
+/*
+ * API
+ * ===
+ */
+
+bool isBinaryFilename(const std::string& filename)
+{
+    const size_t extSize = sizeof(FILE_EXTENSION) - 1;
+
+    return filename.size() > extSize
+           && filename.compare(filename.size() - extSize, extSize, FILE_EXTENSION) == 0;
+}
+
+void readFile(FrameSet& frameSet, const std::string& filename)
+{
+    BinaryFile file(filename);
+
+    FrameSetReader::readFrameSet(frameSet, file);
+}
+
+void writeFile(const FrameSet& frameSet, std::ostream& file)
+{
+    FrameSetWriter writer;
+
+    writer.addFrameSet(frameSet);
+    writer.write(file);
+}
+
+void writeFile(const FrameSet& frameSet, const std::string& filename)
+{
+    FrameSetWriter writer;
+    writer.addFrameSet(frameSet);
+
+    UnTech::AtomicOfStream file(filename, std::ios_base::out | std::ios_base::binary);
+
+    writer.write(file);
+
+    file.commit();
+}
+}
+}
+}
@@ -0,0 +1,37 @@
+#ifndef _UNTECH_MODELS_METASPRITE_BINARYSERIALIZER_H
+#define _UNTECH_MODELS_METASPRITE_BINARYSERIALIZER_H
+
+#include <string>
+#include <ostream>
+
+/**
+ * YOU SHOULD NOT CALL THIS CLASS DIRECTLY.
+ *
+ * It is called by the MetaSpriteDocument class.
+ *
+ * The file format is described in binaryformat.h
+ */
+
+namespace UnTech {
+namespace MetaSprite {
+
+class FrameSet;
+
+namespace BinarySerializer {
+
+const static char FILE_EXTENSION[] = ".utmb";
+
+// Returns true if the filename ends in FILE_EXTENSION
+bool isBinaryFilename(const std::string& filename);
+
+// NOTE: FrameSet MUST be empty
+void readFile(FrameSet& frameSet, const std::string& filename);
+
+void writeFile(const FrameSet& frameSet, std::ostream& file);
+
+void writeFile(const FrameSet& frameSet, const std::string& filename);
+}
+}
+}
+
+#endif
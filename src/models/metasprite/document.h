@@ -3,6 +3,7 @@
 
 #include "frameset.h"
 #include "serializer.h"
+#include "binaryserializer.h"
 #include "../document.h"
 #include <string>
 
@@ -28,7 +29,12 @@ public:
         : Document(filename)
         , _frameSet(*this)
     {
-        Serializer::readFile(_frameSet, filename);
+        if (BinarySerializer::isBinaryFilename(filename)) {
+            BinarySerializer::readFile(_frameSet, filename);
+        }
+        else {
+            Serializer::readFile(_frameSet, filename);
+        }
     }
 
     virtual ~MetaSpriteDocument() = default;
@@ -38,7 +44,12 @@ public:
 
     virtual void writeDataFile(const std::string& filename) override
     {
-        Serializer::writeFile(_frameSet, filename);
+        if (BinarySerializer::isBinaryFilename(filename)) {
+            BinarySerializer::writeFile(_frameSet, filename);
+        }
+        else {
+            Serializer::writeFile(_frameSet, filename);
+        }
         setFilename(filename);
     }
 
@@ -15,6 +15,9 @@ Frame::Frame(FrameSet& frameSet)
     , _entityHitboxes(*this)
     , _solid(true)
     , _tileHitbox(-8, -8, 16, 16)
+    , _renderList()
+    , _renderListRevision(0)
+    , _renderListValid(false)
 {
 }
 
@@ -25,6 +28,9 @@ Frame::Frame(const Frame& frame, FrameSet& frameSet)
     , _entityHitboxes(*this)
     , _solid(frame._solid)
     , _tileHitbox(frame._tileHitbox)
+    , _renderList()
+    , _renderListRevision(0)
+    , _renderListValid(false)
 {
     for (const auto& obj : frame._objects) {
         _objects.clone(obj);
@@ -101,24 +107,60 @@ Frame::Boundary Frame::calcBoundary() const
              (unsigned)top - bottom };
 }
 
-void Frame::draw(Image& image, const Palette& palette, unsigned xOffset, unsigned yOffset) const
+const std::vector<Frame::DrawCommand>& Frame::renderList() const
 {
-    for (int order = 0; order < 4; order++) {
-        for (auto it = _objects.rbegin(); it != _objects.rend(); ++it) {
-            const FrameObject& obj = *it;
-
-            if (obj.order() == order) {
-                if (obj.size() == FrameObject::ObjectSize::SMALL) {
-                    _frameSet.smallTileset().drawTile(image, palette,
-                                                      xOffset + obj.location().x, yOffset + obj.location().y,
-                                                      obj.tileId(), obj.hFlip(), obj.vFlip());
-                }
-                else {
-                    _frameSet.largeTileset().drawTile(image, palette,
-                                                      xOffset + obj.location().x, yOffset + obj.location().y,
-                                                      obj.tileId(), obj.hFlip(), obj.vFlip());
-                }
-            }
+    if (_renderListValid && _renderListRevision == _objects.revision()) {
+        return _renderList;
+    }
+
+    const unsigned N_ORDERS = FrameObject::ORDER_MASK + 1;
+
+    // counting sort by order, the objects are drawn last to first.
+    unsigned pos[N_ORDERS] = {};
+    for (const FrameObject& obj : _objects) {
+        const unsigned order = obj.order();
+        if (order + 1 < N_ORDERS) {
+            pos[order + 1]++;
+        }
+    }
+    for (unsigned o = 1; o < N_ORDERS; o++) {
+        pos[o] += pos[o - 1];
+    }
+
+    _renderList.resize(_objects.size());
+
+    for (auto it = _objects.rbegin(); it != _objects.rend(); ++it) {
+        const FrameObject& obj = *it;
+
+        DrawCommand& c = _renderList[pos[obj.order()]++];
+        c.x = obj.location().x;
+        c.y = obj.location().y;
+        c.tileId = obj.tileId();
+        c.large = obj.size() == FrameObject::ObjectSize::LARGE;
+        c.hFlip = obj.hFlip();
+        c.vFlip = obj.vFlip();
+    }
+
+    _renderListRevision = _objects.revision();
+    _renderListValid = true;
+
+    return _renderList;
+}
+
+void Frame::draw(Image& image, const Palette& palette, int xOffset, int yOffset) const
+{
+    const auto& smallTileset = _frameSet.smallTileset();
+    const auto& largeTileset = _frameSet.largeTileset();
+
+    for (const DrawCommand& c : renderList()) {
+        const int x = xOffset + c.x;
+        const int y = yOffset + c.y;
+
+        if (!c.large) {
+            smallTileset.drawTileClipped(image, palette, x, y, c.tileId, c.hFlip, c.vFlip);
+        }
+        else {
+            largeTileset.drawTileClipped(image, palette, x, y, c.tileId, c.hFlip, c.vFlip);
         }
     }
 }
@@ -7,6 +7,7 @@
 #include "../common/namedlist.h"
 #include "../common/orderedlist.h"
 #include <memory>
+#include <vector>
 
 namespace UnTech {
 namespace MetaSprite {
@@ -49,8 +50,31 @@ public:
     };
     Boundary calcBoundary() const;
 
+    // A frame object in the form used by the renderer.
+    struct DrawCommand {
+        int x, y;
+        unsigned tileId;
+        bool large;
+        bool hFlip;
+        bool vFlip;
+    };
+
+    /**
+     * The frame objects in the order they are drawn (lowest order first,
+     * then last object first).
+     *
+     * The list is cached and rebuilt when an object is added, removed,
+     * moved or changed.
+     *
+     * THREADS: NOT THREAD SAFE, the cache is updated by this const method.
+     */
+    const std::vector<DrawCommand>& renderList() const;
+
+    inline void invalidateRenderList() { _renderListValid = false; }
+
+    // The objects are clipped to the image, so the offset may be negative.
     void draw(Image& image, const Palette& palette,
-              unsigned xOffset = 0, unsigned yOffset = 0) const;
+              int xOffset = 0, int yOffset = 0) const;
 
 private:
     FrameSet& _frameSet;
@@ -60,6 +84,10 @@ private:
 
     bool _solid;
     ms8rect _tileHitbox;
+
+    mutable std::vector<DrawCommand> _renderList;
+    mutable unsigned _renderListRevision;
+    mutable bool _renderListValid;
 };
 }
 }
@@ -60,12 +60,36 @@ public:
 
     inline unsigned sizePx() const { return (unsigned)_size; }
 
-    inline void setLocation(const ms8point& location) { _location = location; }
-    inline void setSize(ObjectSize size) { _size = size; }
-    inline void setTileId(unsigned tileId) { _tileId = tileId; }
-    inline void setOrder(uint_fast8_t order) { _order = order & ORDER_MASK; }
-    inline void setHFlip(bool hFlip) { _hFlip = hFlip; }
-    inline void setVFlip(bool vFlip) { _vFlip = vFlip; }
+    inline void setLocation(const ms8point& location)
+    {
+        _location = location;
+        _frame.invalidateRenderList();
+    }
+    inline void setSize(ObjectSize size)
+    {
+        _size = size;
+        _frame.invalidateRenderList();
+    }
+    inline void setTileId(unsigned tileId)
+    {
+        _tileId = tileId;
+        _frame.invalidateRenderList();
+    }
+    inline void setOrder(uint_fast8_t order)
+    {
+        _order = order & ORDER_MASK;
+        _frame.invalidateRenderList();
+    }
+    inline void setHFlip(bool hFlip)
+    {
+        _hFlip = hFlip;
+        _frame.invalidateRenderList();
+    }
+    inline void setVFlip(bool vFlip)
+    {
+        _vFlip = vFlip;
+        _frame.invalidateRenderList();
+    }
 
 private:
     Frame& _frame;
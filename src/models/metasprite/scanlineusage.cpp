@@ -0,0 +1,127 @@
+#include "scanlineusage.h"
+#include "frameobject.h"
+#include <algorithm>
+
+using namespace UnTech;
+using namespace UnTech::MetaSprite;
+
+const unsigned FrameScanlineUsage::MAX_OBJECTS_PER_LINE;
+const unsigned FrameScanlineUsage::MAX_SLIVERS_PER_LINE;
+const unsigned FrameScanlineUsage::MAX_OAM_OBJECTS;
+const int FrameScanlineUsage::FIRST_LINE;
+const unsigned FrameScanlineUsage::N_LINES;
+
+FrameScanlineUsage::FrameScanlineUsage(const Frame& frame)
+    : _lines(N_LINES)
+    , _nObjects(0)
+    , _maxObjectsPerLine(0)
+    , _maxSliversPerLine(0)
+    , _worstLine(0)
+{
+    for (const FrameObject& obj : frame.objects()) {
+        const unsigned size = obj.sizePx();
+        const unsigned nSlivers = size / 8;
+        const unsigned top = obj.location().y - FIRST_LINE;
+
+        for (unsigned y = top; y < top + size; y++) {
+            _lines[y].nObjects++;
+            _lines[y].nSlivers += nSlivers;
+        }
+
+        _nObjects++;
+    }
+
+    unsigned worstObjects = 0;
+
+    for (unsigned i = 0; i < N_LINES; i++) {
+        const Line& l = _lines[i];
+
+        _maxObjectsPerLine = std::max(_maxObjectsPerLine, l.nObjects);
+
+        if (l.nSlivers > _maxSliversPerLine
+            || (l.nSlivers == _maxSliversPerLine && l.nObjects > worstObjects)) {
+
+            _maxSliversPerLine = l.nSlivers;
+            worstObjects = l.nObjects;
+            _worstLine = int(i) + FIRST_LINE;
+        }
+    }
+}
+
+std::vector<std::pair<int, int>> FrameScanlineUsage::linesOverLimits(const Limits& limits) const
+{
+    std::vector<std::pair<int, int>> ret;
+
+    bool inRun = false;
+
+    for (unsigned i = 0; i < N_LINES; i++) {
+        const int y = int(i) + FIRST_LINE;
+
+        if (lineOverLimits(y, limits)) {
+            if (inRun) {
+                ret.back().second = y;
+            }
+            else {
+                ret.emplace_back(y, y);
+                inRun = true;
+            }
+        }
+        else {
+            inRun = false;
+        }
+    }
+
+    return ret;
+}
+
+bool FrameScanlineUsage::overLimits(const Limits& limits) const
+{
+    return _nObjects > limits.oamObjects
+           || _maxObjectsPerLine > limits.objectsPerLine
+           || _maxSliversPerLine > limits.sliversPerLine;
+}
+
+FrameSetScanlineUsage::FrameSetScanlineUsage(const FrameSet& frameSet)
+{
+    for (const auto frameIt : frameSet.frames()) {
+        _frames.emplace_back(frameIt.first, FrameScanlineUsage(frameIt.second));
+    }
+}
+
+unsigned FrameSetScanlineUsage::maxObjects() const
+{
+    unsigned ret = 0;
+    for (const auto& f : _frames) {
+        ret = std::max(ret, f.second.nObjects());
+    }
+    return ret;
+}
+
+unsigned FrameSetScanlineUsage::maxObjectsPerLine() const
+{
+    unsigned ret = 0;
+    for (const auto& f : _frames) {
+        ret = std::max(ret, f.second.maxObjectsPerLine());
+    }
+    return ret;
+}
+
+unsigned FrameSetScanlineUsage::maxSliversPerLine() const
+{
+    unsigned ret = 0;
+    for (const auto& f : _frames) {
+        ret = std::max(ret, f.second.maxSliversPerLine());
+    }
+    return ret;
+}
+
+unsigned FrameSetScanlineUsage::nFramesOverLimits(const FrameScanlineUsage::Limits& limits) const
+{
+    unsigned ret = 0;
+    for (const auto& f : _frames) {
+        if (f.second.overLimits(limits)) {
+            ret++;
+        }
+    }
+    return ret;
+}
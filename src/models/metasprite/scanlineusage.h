@@ -0,0 +1,106 @@
+#ifndef _UNTECH_MODELS_METASPRITE_SCANLINEUSAGE_H
+#define _UNTECH_MODELS_METASPRITE_SCANLINEUSAGE_H
+
+#include "frame.h"
+#include "../common/int_ms8_t.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace UnTech {
+namespace MetaSprite {
+
+/**
+ * The number of objects and 8px wide tile slivers on each scanline of a
+ * frame.
+ *
+ * The SNES PPU can only display 32 objects and 34 slivers on a
+ * scanline, the objects/slivers past these limits are not drawn.
+ * As the frame is only part of a scene, the limits can be lowered
+ * to the budget allocated to a single entity.
+ */
+class FrameScanlineUsage {
+public:
+    const static unsigned MAX_OBJECTS_PER_LINE = 32;
+    const static unsigned MAX_SLIVERS_PER_LINE = 34;
+    const static unsigned MAX_OAM_OBJECTS = 128;
+
+    // y position of lines()[0], relative to the frame origin
+    const static int FIRST_LINE = int_ms8_t::MIN;
+    const static unsigned N_LINES = 256 + 16;
+
+    struct Line {
+        unsigned nObjects = 0;
+        unsigned nSlivers = 0;
+    };
+
+    struct Limits {
+        unsigned objectsPerLine = MAX_OBJECTS_PER_LINE;
+        unsigned sliversPerLine = MAX_SLIVERS_PER_LINE;
+        unsigned oamObjects = MAX_OAM_OBJECTS;
+    };
+
+public:
+    FrameScanlineUsage() = delete;
+    FrameScanlineUsage(const Frame& frame);
+
+    inline const std::vector<Line>& lines() const { return _lines; }
+    inline const Line& line(int y) const { return _lines.at(y - FIRST_LINE); }
+
+    // Number of OAM entries used by the frame
+    inline unsigned nObjects() const { return _nObjects; }
+
+    inline unsigned maxObjectsPerLine() const { return _maxObjectsPerLine; }
+    inline unsigned maxSliversPerLine() const { return _maxSliversPerLine; }
+
+    // The first line with the most slivers (ties broken by object count).
+    // Only valid if the frame has objects.
+    inline int worstLine() const { return _worstLine; }
+
+    inline bool lineOverLimits(int y, const Limits& limits) const
+    {
+        const Line& l = line(y);
+        return l.nObjects > limits.objectsPerLine || l.nSlivers > limits.sliversPerLine;
+    }
+
+    // Returns the [first, last] y position of each run of lines over
+    // the limits.
+    std::vector<std::pair<int, int>> linesOverLimits(const Limits& limits) const;
+
+    bool overLimits(const Limits& limits) const;
+
+private:
+    std::vector<Line> _lines;
+    unsigned _nObjects;
+    unsigned _maxObjectsPerLine;
+    unsigned _maxSliversPerLine;
+    int _worstLine;
+};
+
+/**
+ * The FrameScanlineUsage of every frame in a frameset.
+ */
+class FrameSetScanlineUsage {
+public:
+    typedef std::pair<std::string, FrameScanlineUsage> frame_usage_t;
+
+public:
+    FrameSetScanlineUsage() = delete;
+    FrameSetScanlineUsage(const FrameSet& frameSet);
+
+    // sorted by frame name
+    inline const std::vector<frame_usage_t>& frames() const { return _frames; }
+
+    unsigned maxObjects() const;
+    unsigned maxObjectsPerLine() const;
+    unsigned maxSliversPerLine() const;
+
+    unsigned nFramesOverLimits(const FrameScanlineUsage::Limits& limits) const;
+
+private:
+    std::vector<frame_usage_t> _frames;
+};
+}
+}
+
+#endif
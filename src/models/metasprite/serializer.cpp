@@ -10,7 +10,9 @@
 #include "../common/xml/xmlwriter.h"
 #include "../snes/palette.hpp"
 #include "../snes/tileset.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 #include <fstream>
 
@@ -145,32 +147,63 @@ private:
         frame.setSolid(processedTileHitbox);
     }
 
+    // Decodes the base64 text straight into the tileset, one block at a time.
+    // Returns the number of bytes decoded.
+    template <class TilesetT>
+    inline size_t readTilesetData(TilesetT& tileset)
+    {
+        const size_t TILE_SIZE = TilesetT::SNES_DATA_SIZE;
+
+        // holds a tile that is split across two blocks
+        uint8_t partialTile[TILE_SIZE];
+        size_t partialSize = 0;
+
+        return xml.parseBase64([&](const uint8_t* data, size_t size) {
+            if (partialSize > 0) {
+                size_t n = std::min(TILE_SIZE - partialSize, size);
+
+                memcpy(partialTile + partialSize, data, n);
+                partialSize += n;
+                data += n;
+                size -= n;
+
+                if (partialSize < TILE_SIZE) {
+                    return;
+                }
+                tileset.readSnesData(partialTile, TILE_SIZE);
+                partialSize = 0;
+            }
+
+            size_t wholeTiles = size - (size % TILE_SIZE);
+            tileset.readSnesData(data, wholeTiles);
+
+            memcpy(partialTile, data + wholeTiles, size - wholeTiles);
+            partialSize = size - wholeTiles;
+        });
+    }
+
     inline void readSmallTileset(const XmlTag* tag)
     {
         assert(tag->name == "smalltileset");
 
-        const auto data = xml.parseBase64();
+        const size_t size = readTilesetData(frameSet.smallTileset());
 
         static_assert(Snes::Tileset4bpp8px::SNES_DATA_SIZE == 32, "Bad assumption");
-        if ((data.size() % 32) != 0) {
+        if ((size % 32) != 0) {
             throw tag->buildError("Small Tileset data must be a multiple of 32 bytes");
         }
-
-        frameSet.smallTileset().readSnesData(data);
     }
 
     inline void readLargeTileset(const XmlTag* tag)
     {
         assert(tag->name == "largetileset");
 
-        const auto data = xml.parseBase64();
+        const size_t size = readTilesetData(frameSet.largeTileset());
 
         static_assert(Snes::Tileset4bpp16px::SNES_DATA_SIZE == 128, "Bad assumption");
-        if ((data.size() % 128) != 0) {
+        if ((size % 128) != 0) {
             throw tag->buildError("Large Tileset data must be a multiple of 128 bytes");
         }
-
-        frameSet.largeTileset().readSnesData(data);
     }
 
     inline void readPalette(const XmlTag* tag)
@@ -0,0 +1,348 @@
+#include "tilesetorder.h"
+#include "frameobject.h"
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <vector>
+
+using namespace UnTech;
+using namespace UnTech::MetaSprite;
+
+namespace UnTech {
+namespace MetaSprite {
+namespace TilesetOrderPrivate {
+
+// Returns the number of runs in a list of tile ids, the list is sorted
+// and the duplicates removed.
+inline unsigned countRuns(std::vector<unsigned>& tileIds)
+{
+    std::sort(tileIds.begin(), tileIds.end());
+    tileIds.erase(std::unique(tileIds.begin(), tileIds.end()), tileIds.end());
+
+    unsigned nRuns = 0;
+    for (unsigned i = 0; i < tileIds.size(); i++) {
+        if (i == 0 || tileIds[i] != tileIds[i - 1] + 1) {
+            nRuns++;
+        }
+    }
+    return nRuns;
+}
+
+// The tile ids used by each frame, ids past the end of the tileset are
+// ignored.
+typedef std::vector<std::vector<unsigned>> frameTiles_t;
+
+inline unsigned countRuns(const frameTiles_t& frameTiles, const std::vector<unsigned>& newIds)
+{
+    unsigned nRuns = 0;
+    std::vector<unsigned> ids;
+
+    for (const auto& tiles : frameTiles) {
+        ids.clear();
+        for (unsigned t : tiles) {
+            ids.push_back(newIds[t]);
+        }
+        nRuns += countRuns(ids);
+    }
+    return nRuns;
+}
+
+// Returns the new id of each tile
+std::vector<unsigned> calculateTileOrder(const frameTiles_t& frameTiles, const unsigned nTiles)
+{
+    // the frames that use each tile, in frame order.
+    std::vector<std::vector<unsigned>> tileFrames(nTiles);
+
+    for (unsigned f = 0; f < frameTiles.size(); f++) {
+        for (unsigned t : frameTiles[f]) {
+            auto& tf = tileFrames[t];
+            if (tf.empty() || tf.back() != f) {
+                tf.push_back(f);
+            }
+        }
+    }
+
+    // Tiles used by the same set of frames are always placed together.
+    std::vector<std::vector<unsigned>> groupTiles;
+    std::vector<unsigned> tileGroup(nTiles);
+    unsigned unusedGroup = nTiles;
+    {
+        std::map<std::vector<unsigned>, unsigned> groupMap;
+
+        for (unsigned t = 0; t < nTiles; t++) {
+            auto it = groupMap.find(tileFrames[t]);
+            if (it == groupMap.end()) {
+                it = groupMap.emplace(tileFrames[t], groupTiles.size()).first;
+                groupTiles.emplace_back();
+
+                if (tileFrames[t].empty()) {
+                    unusedGroup = it->second;
+                }
+            }
+            tileGroup[t] = it->second;
+            groupTiles[it->second].push_back(t);
+        }
+    }
+    const unsigned nGroups = groupTiles.size();
+
+    // The number of runs saved by placing two groups next to each
+    // other is the number of frames that use both of them.
+    std::map<std::pair<unsigned, unsigned>, unsigned> edgeWeights;
+    {
+        std::vector<unsigned> groups;
+
+        for (const auto& tiles : frameTiles) {
+            groups.clear();
+            for (unsigned t : tiles) {
+                groups.push_back(tileGroup[t]);
+            }
+            std::sort(groups.begin(), groups.end());
+            groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+
+            for (unsigned i = 0; i < groups.size(); i++) {
+                for (unsigned j = i + 1; j < groups.size(); j++) {
+                    edgeWeights[std::make_pair(groups[i], groups[j])]++;
+                }
+            }
+        }
+    }
+
+    struct Edge {
+        unsigned weight;
+        unsigned a, b;
+    };
+    std::vector<Edge> edges;
+    edges.reserve(edgeWeights.size());
+    for (const auto& it : edgeWeights) {
+        edges.push_back({ it.second, it.first.first, it.first.second });
+    }
+    std::stable_sort(edges.begin(), edges.end(),
+                     [](const Edge& e1, const Edge& e2) { return e1.weight > e2.weight; });
+
+    // Greedily chain the groups into paths, heaviest edges first.
+    std::vector<std::vector<unsigned>> links(nGroups);
+    std::vector<unsigned> component(nGroups);
+    std::iota(component.begin(), component.end(), 0);
+
+    auto findComponent = [&](unsigned g) {
+        while (component[g] != g) {
+            component[g] = component[component[g]];
+            g = component[g];
+        }
+        return g;
+    };
+
+    for (const Edge& e : edges) {
+        if (links[e.a].size() < 2 && links[e.b].size() < 2) {
+            unsigned ca = findComponent(e.a);
+            unsigned cb = findComponent(e.b);
+
+            if (ca != cb) {
+                component[ca] = cb;
+                links[e.a].push_back(e.b);
+                links[e.b].push_back(e.a);
+            }
+        }
+    }
+
+    // Walk the paths in order of their first tile, unused tiles last.
+    std::vector<unsigned> groupOrder;
+    groupOrder.reserve(nGroups);
+    std::vector<bool> visited(nGroups, false);
+
+    for (unsigned g = 0; g < nGroups; g++) {
+        if (visited[g] || g == unusedGroup) {
+            continue;
+        }
+
+        // find an end of the path
+        unsigned start = g;
+        unsigned prev = nGroups;
+        while (links[start].size() == 2 || (links[start].size() == 1 && links[start][0] != prev)) {
+            unsigned next = links[start][0] != prev ? links[start][0] : links[start][1];
+            prev = start;
+            start = next;
+        }
+
+        prev = nGroups;
+        unsigned current = start;
+        while (current < nGroups) {
+            visited[current] = true;
+            groupOrder.push_back(current);
+
+            unsigned next = nGroups;
+            for (unsigned l : links[current]) {
+                if (l != prev) {
+                    next = l;
+                }
+            }
+            prev = current;
+            current = next;
+        }
+    }
+    if (unusedGroup < nGroups) {
+        groupOrder.push_back(unusedGroup);
+    }
+
+    std::vector<unsigned> newIds(nTiles);
+    unsigned id = 0;
+    for (unsigned g : groupOrder) {
+        for (unsigned t : groupTiles[g]) {
+            newIds[t] = id++;
+        }
+    }
+    return newIds;
+}
+
+template <class TilesetT>
+bool reorderTileset(TilesetT& tileset, const std::vector<std::vector<FrameObject*>>& frameObjects)
+{
+    const unsigned nTiles = tileset.size();
+
+    frameTiles_t frameTiles;
+    frameTiles.reserve(frameObjects.size());
+
+    for (const auto& objects : frameObjects) {
+        frameTiles.emplace_back();
+        for (const FrameObject* obj : objects) {
+            if (obj->tileId() < nTiles) {
+                frameTiles.back().push_back(obj->tileId());
+            }
+        }
+    }
+
+    std::vector<unsigned> identity(nTiles);
+    std::iota(identity.begin(), identity.end(), 0);
+
+    const std::vector<unsigned> newIds = calculateTileOrder(frameTiles, nTiles);
+
+    if (countRuns(frameTiles, newIds) >= countRuns(frameTiles, identity)) {
+        return false;
+    }
+
+    std::vector<typename TilesetT::tileData_t> oldTiles;
+    oldTiles.reserve(nTiles);
+    for (unsigned t = 0; t < nTiles; t++) {
+        oldTiles.push_back(tileset.tile(t));
+    }
+    for (unsigned t = 0; t < nTiles; t++) {
+        tileset.tile(newIds[t]) = oldTiles[t];
+    }
+
+    for (const auto& objects : frameObjects) {
+        for (FrameObject* obj : objects) {
+            if (obj->tileId() < nTiles) {
+                obj->setTileId(newIds[obj->tileId()]);
+            }
+        }
+    }
+
+    return true;
+}
+
+template <class TilesetT>
+unsigned removeUnusedTiles(TilesetT& tileset, const std::vector<FrameObject*>& objects)
+{
+    const unsigned nTiles = tileset.size();
+
+    std::vector<bool> used(nTiles, false);
+    for (const FrameObject* obj : objects) {
+        if (obj->tileId() < nTiles) {
+            used[obj->tileId()] = true;
+        }
+    }
+
+    std::vector<unsigned> newIds(nTiles);
+    unsigned n = 0;
+
+    for (unsigned t = 0; t < nTiles; t++) {
+        if (used[t]) {
+            if (n != t) {
+                tileset.tile(n) = tileset.tile(t);
+            }
+            newIds[t] = n++;
+        }
+    }
+    tileset.truncate(n);
+
+    for (FrameObject* obj : objects) {
+        if (obj->tileId() < nTiles) {
+            obj->setTileId(newIds[obj->tileId()]);
+        }
+    }
+
+    return nTiles - n;
+}
+
+inline void splitObjectsBySize(Frame& frame,
+                               std::vector<FrameObject*>& smallObjects,
+                               std::vector<FrameObject*>& largeObjects)
+{
+    for (FrameObject& obj : frame.objects()) {
+        if (obj.size() == FrameObject::ObjectSize::SMALL) {
+            smallObjects.push_back(&obj);
+        }
+        else {
+            largeObjects.push_back(&obj);
+        }
+    }
+}
+}
+}
+}
+
+using namespace UnTech::MetaSprite::TilesetOrderPrivate;
+
+FrameDmaUsage UnTech::MetaSprite::frameDmaUsage(const Frame& frame)
+{
+    std::vector<unsigned> smallTiles;
+    std::vector<unsigned> largeTiles;
+
+    for (const FrameObject& obj : frame.objects()) {
+        if (obj.size() == FrameObject::ObjectSize::SMALL) {
+            smallTiles.push_back(obj.tileId());
+        }
+        else {
+            largeTiles.push_back(obj.tileId());
+        }
+    }
+
+    FrameDmaUsage ret;
+
+    ret.nTransfers = countRuns(smallTiles) + countRuns(largeTiles);
+    ret.nBytes = smallTiles.size() * Snes::Tileset4bpp8px::SNES_DATA_SIZE
+                 + largeTiles.size() * Snes::Tileset4bpp16px::SNES_DATA_SIZE;
+
+    return ret;
+}
+
+bool UnTech::MetaSprite::optimizeTilesetOrder(FrameSet& frameSet)
+{
+    std::vector<std::vector<FrameObject*>> smallObjects;
+    std::vector<std::vector<FrameObject*>> largeObjects;
+
+    for (auto frameIt : frameSet.frames()) {
+        smallObjects.emplace_back();
+        largeObjects.emplace_back();
+
+        splitObjectsBySize(frameIt.second, smallObjects.back(), largeObjects.back());
+    }
+
+    bool changed = reorderTileset(frameSet.smallTileset(), smallObjects);
+    changed |= reorderTileset(frameSet.largeTileset(), largeObjects);
+
+    return changed;
+}
+
+unsigned UnTech::MetaSprite::removeUnusedTiles(FrameSet& frameSet)
+{
+    std::vector<FrameObject*> smallObjects;
+    std::vector<FrameObject*> largeObjects;
+
+    for (auto frameIt : frameSet.frames()) {
+        splitObjectsBySize(frameIt.second, smallObjects, largeObjects);
+    }
+
+    return TilesetOrderPrivate::removeUnusedTiles(frameSet.smallTileset(), smallObjects)
+           + TilesetOrderPrivate::removeUnusedTiles(frameSet.largeTileset(), largeObjects);
+}
@@ -0,0 +1,51 @@
+#ifndef _UNTECH_MODELS_METASPRITE_TILESETORDER_H
+#define _UNTECH_MODELS_METASPRITE_TILESETORDER_H
+
+#include "frame.h"
+#include "frameset.h"
+
+namespace UnTech {
+namespace MetaSprite {
+
+/**
+ * The DMA transfers required to load the tiles of a frame into VRAM.
+ *
+ * Each run of consecutive tile ids (in either tileset) is a single
+ * transfer, as the engine stores the 16px tiles sequentially in ROM.
+ */
+struct FrameDmaUsage {
+    unsigned nTransfers = 0;
+    unsigned nBytes = 0;
+};
+
+FrameDmaUsage frameDmaUsage(const Frame& frame);
+
+/**
+ * Reorders the tiles of the frameset's tilesets so the tiles used by
+ * each frame form as few contiguous runs as possible and remaps the
+ * tileIds of the frame objects to match.
+ *
+ * Tiles that are used by the same frames are kept together and the
+ * groups of tiles are chained so that groups sharing the most frames are
+ * adjacent. Unused tiles are moved to the end of the tileset.
+ *
+ * A tileset is left unchanged if the new order does not reduce the
+ * number of transfers.
+ *
+ * Returns true if the frameset was changed.
+ */
+bool optimizeTilesetOrder(FrameSet& frameSet);
+
+/**
+ * Removes the tiles that are not used by any frame object and remaps the
+ * tileIds of the frame objects to match.
+ *
+ * The order of the remaining tiles is unchanged.
+ *
+ * Returns the number of tiles removed.
+ */
+unsigned removeUnusedTiles(FrameSet& frameSet);
+}
+}
+
+#endif
@@ -0,0 +1,346 @@
+#include "bitplanes.h"
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define UNTECH_BITPLANES_AVX2
+#endif
+
+using namespace UnTech::Snes;
+
+namespace {
+
+typedef void (*ReadFunction)(const uint8_t* planar, uint8_t* tiles, size_t count);
+typedef void (*WriteFunction)(const uint8_t* tiles, uint8_t* planar, size_t count);
+
+struct Implementation {
+    const char* name;
+
+    // indexed by bitDepth / 2 - 1
+    ReadFunction read[4];
+    WriteFunction write[4];
+};
+
+/*
+ * In the SNES bitplane format the bits of each 8px tile row are stored
+ * in pairs of bitplanes, 16 bytes per pair:
+ *
+ *      planar[(b / 2) * 16 + y * 2 + (b & 1)] = bit `b` of row `y`
+ *
+ * The leftmost pixel is the MSB of each byte.
+ */
+
+/*
+ * SCALAR
+ * ======
+ *
+ * Processes a whole row at a time inside a uint64_t.
+ */
+
+// Each entry contains 8 bytes (in memory order), byte `x` is bit `7 - x`
+// of the index.
+struct ExpandTable {
+    uint64_t rows[256];
+
+    ExpandTable()
+    {
+        for (unsigned i = 0; i < 256; i++) {
+            uint8_t row[8];
+            for (unsigned x = 0; x < 8; x++) {
+                row[x] = (i >> (7 - x)) & 1;
+            }
+            memcpy(&rows[i], row, sizeof(row));
+        }
+    }
+};
+
+const ExpandTable& expandTable()
+{
+    static const ExpandTable table;
+    return table;
+}
+
+template <unsigned BD>
+void readTilesScalar(const uint8_t* planar, uint8_t* tiles, size_t count)
+{
+    const ExpandTable& table = expandTable();
+
+    for (size_t i = 0; i < count; i++) {
+        for (unsigned y = 0; y < 8; y++) {
+            uint64_t row = 0;
+
+            for (unsigned b = 0; b < BD; b++) {
+                row |= table.rows[planar[(b / 2) * 16 + y * 2 + (b & 1)]] << b;
+            }
+
+            memcpy(tiles + y * 8, &row, sizeof(row));
+        }
+
+        planar += BD * 8;
+        tiles += 64;
+    }
+}
+
+template <unsigned BD>
+void writeTilesScalar(const uint8_t* tiles, uint8_t* planar, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        for (unsigned y = 0; y < 8; y++) {
+            uint64_t row;
+            memcpy(&row, tiles + y * 8, sizeof(row));
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            row = __builtin_bswap64(row);
+#endif
+
+            // Gathers bit 0 of each byte into the top byte,
+            // byte 0 (the leftmost pixel) becomes the MSB.
+            for (unsigned b = 0; b < BD; b++) {
+                const uint64_t bits = (row >> b) & 0x0101010101010101ULL;
+
+                planar[(b / 2) * 16 + y * 2 + (b & 1)] = (bits * 0x8040201008040201ULL) >> 56;
+            }
+        }
+
+        tiles += 64;
+        planar += BD * 8;
+    }
+}
+
+const Implementation SCALAR_IMPLEMENTATION = {
+    "scalar",
+    { readTilesScalar<2>, readTilesScalar<4>, readTilesScalar<6>, readTilesScalar<8> },
+    { writeTilesScalar<2>, writeTilesScalar<4>, writeTilesScalar<6>, writeTilesScalar<8> },
+};
+
+/*
+ * SSE2
+ * ====
+ *
+ * Writes two rows at a time using movemask.
+ *
+ * SSE2 has no byte shuffle to broadcast the bitplane bytes, so
+ * reading uses the scalar code.
+ */
+
+#ifdef __SSE2__
+
+// Reverses the pixel order of both rows so the leftmost pixel
+// is in the MSB of the movemask byte.
+inline __m128i reverseRowsSse2(__m128i v)
+{
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+template <unsigned BD>
+void writeTilesSse2(const uint8_t* tiles, uint8_t* planar, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        for (unsigned r = 0; r < 4; r++) {
+            const __m128i rows = reverseRowsSse2(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(tiles + r * 16)));
+
+            for (unsigned b = 0; b < BD; b++) {
+                // move bit `b` of each pixel into the MSB
+                const unsigned bits = _mm_movemask_epi8(
+                    _mm_sll_epi16(rows, _mm_cvtsi32_si128(7 - b)));
+
+                uint8_t* out = planar + (b / 2) * 16 + r * 4 + (b & 1);
+                out[0] = bits;
+                out[2] = bits >> 8;
+            }
+        }
+
+        tiles += 64;
+        planar += BD * 8;
+    }
+}
+
+const Implementation SSE2_IMPLEMENTATION = {
+    "sse2",
+    { readTilesScalar<2>, readTilesScalar<4>, readTilesScalar<6>, readTilesScalar<8> },
+    { writeTilesSse2<2>, writeTilesSse2<4>, writeTilesSse2<6>, writeTilesSse2<8> },
+};
+
+#endif
+
+/*
+ * AVX2
+ * ====
+ *
+ * Processes four rows at a time.
+ *
+ * Reading broadcasts each bitplane byte across its row with a
+ * byte shuffle, then tests the bits of each pixel.
+ */
+
+#ifdef UNTECH_BITPLANES_AVX2
+
+template <unsigned BD>
+__attribute__((target("avx2"))) void readTilesAvx2(const uint8_t* planar, uint8_t* tiles, size_t count)
+{
+    // the bit of each pixel in a bitplane byte
+    const __m256i pixelBits = _mm256_set1_epi64x(0x0102040810204080LL);
+
+    // selects the bitplane 0 bytes of rows 0-3
+    const __m256i rowIndex = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0,
+                                              2, 2, 2, 2, 2, 2, 2, 2,
+                                              4, 4, 4, 4, 4, 4, 4, 4,
+                                              6, 6, 6, 6, 6, 6, 6, 6);
+    const __m256i index[2][2] = {
+        { rowIndex, _mm256_add_epi8(rowIndex, _mm256_set1_epi8(1)) },
+        { _mm256_add_epi8(rowIndex, _mm256_set1_epi8(8)), _mm256_add_epi8(rowIndex, _mm256_set1_epi8(9)) },
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        __m256i rows[2] = { _mm256_setzero_si256(), _mm256_setzero_si256() };
+
+        for (unsigned p = 0; p < BD / 2; p++) {
+            const __m256i pair = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(planar + p * 16)));
+
+            for (unsigned bi = 0; bi < 2; bi++) {
+                const __m256i value = _mm256_set1_epi8(char(1 << (p * 2 + bi)));
+
+                for (unsigned r = 0; r < 2; r++) {
+                    __m256i px = _mm256_shuffle_epi8(pair, index[r][bi]);
+                    px = _mm256_cmpeq_epi8(_mm256_and_si256(px, pixelBits), pixelBits);
+
+                    rows[r] = _mm256_or_si256(rows[r], _mm256_and_si256(px, value));
+                }
+            }
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(tiles), rows[0]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(tiles + 32), rows[1]);
+
+        planar += BD * 8;
+        tiles += 64;
+    }
+}
+
+template <unsigned BD>
+__attribute__((target("avx2"))) void writeTilesAvx2(const uint8_t* tiles, uint8_t* planar, size_t count)
+{
+    // reverses the pixel order of each row
+    const __m256i reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8,
+                                             7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8);
+
+    for (size_t i = 0; i < count; i++) {
+        for (unsigned r = 0; r < 2; r++) {
+            const __m256i rows = _mm256_shuffle_epi8(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tiles + r * 32)),
+                reverse);
+
+            for (unsigned b = 0; b < BD; b++) {
+                const uint32_t bits = _mm256_movemask_epi8(
+                    _mm256_sll_epi16(rows, _mm_cvtsi32_si128(7 - b)));
+
+                uint8_t* out = planar + (b / 2) * 16 + r * 8 + (b & 1);
+                out[0] = bits;
+                out[2] = bits >> 8;
+                out[4] = bits >> 16;
+                out[6] = bits >> 24;
+            }
+        }
+
+        tiles += 64;
+        planar += BD * 8;
+    }
+}
+
+const Implementation AVX2_IMPLEMENTATION = {
+    "avx2",
+    { readTilesAvx2<2>, readTilesAvx2<4>, readTilesAvx2<6>, readTilesAvx2<8> },
+    { writeTilesAvx2<2>, writeTilesAvx2<4>, writeTilesAvx2<6>, writeTilesAvx2<8> },
+};
+
+#endif
+
+// The implementations supported by the CPU, fastest last.
+std::vector<const Implementation*> supportedImplementations()
+{
+    std::vector<const Implementation*> ret = { &SCALAR_IMPLEMENTATION };
+
+#ifdef __SSE2__
+    ret.push_back(&SSE2_IMPLEMENTATION);
+#endif
+
+#ifdef UNTECH_BITPLANES_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        ret.push_back(&AVX2_IMPLEMENTATION);
+    }
+#endif
+
+    return ret;
+}
+
+const std::vector<const Implementation*>& implementations()
+{
+    static const std::vector<const Implementation*> impls = supportedImplementations();
+    return impls;
+}
+
+const Implementation& implementation()
+{
+    static const Implementation& impl = *implementations().back();
+    return impl;
+}
+
+inline unsigned functionIndex(unsigned bitDepth)
+{
+    if (bitDepth < 2 || bitDepth > 8 || (bitDepth & 1) != 0) {
+        throw std::invalid_argument("Invalid bit depth");
+    }
+    return bitDepth / 2 - 1;
+}
+}
+
+void Bitplanes::readTiles(unsigned bitDepth, const uint8_t* planar, uint8_t* tiles, size_t count)
+{
+    implementation().read[functionIndex(bitDepth)](planar, tiles, count);
+}
+
+void Bitplanes::writeTiles(unsigned bitDepth, const uint8_t* tiles, uint8_t* planar, size_t count)
+{
+    implementation().write[functionIndex(bitDepth)](tiles, planar, count);
+}
+
+const char* Bitplanes::implementationName()
+{
+    return implementation().name;
+}
+
+unsigned Bitplanes::nImplementations()
+{
+    return implementations().size();
+}
+
+const char* Bitplanes::implementationName(unsigned implementation)
+{
+    return implementations().at(implementation)->name;
+}
+
+void Bitplanes::readTilesWith(unsigned implementation, unsigned bitDepth,
+                              const uint8_t* planar, uint8_t* tiles, size_t count)
+{
+    implementations().at(implementation)->read[functionIndex(bitDepth)](planar, tiles, count);
+}
+
+void Bitplanes::writeTilesWith(unsigned implementation, unsigned bitDepth,
+                               const uint8_t* tiles, uint8_t* planar, size_t count)
+{
+    implementations().at(implementation)->write[functionIndex(bitDepth)](tiles, planar, count);
+}
@@ -0,0 +1,56 @@
+#ifndef _UNTECH_MODELS_SNES_BITPLANES_H_
+#define _UNTECH_MODELS_SNES_BITPLANES_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace UnTech {
+namespace Snes {
+
+/**
+ * Planar <-> chunky conversion of 8px SNES tiles.
+ *
+ * A chunky tile is 64 bytes, one byte per pixel.
+ * A planar tile is `8 * bitDepth` bytes in the SNES' bitplane format.
+ *
+ * The implementation (AVX2, SSE2 or scalar) is selected at runtime.
+ *
+ * bitDepth MUST be 2, 4, 6 or 8.
+ */
+namespace Bitplanes {
+
+/** Converts `count` planar tiles into `count` chunky tiles */
+void readTiles(unsigned bitDepth, const uint8_t* planar, uint8_t* tiles, size_t count);
+
+/** Converts `count` chunky tiles into `count` planar tiles */
+void writeTiles(unsigned bitDepth, const uint8_t* tiles, uint8_t* planar, size_t count);
+
+/** Returns the name of the selected implementation */
+const char* implementationName();
+
+/*
+ * The implementations supported by the CPU can also be called directly,
+ * for comparing them in tests.
+ *
+ * Implementation 0 is the scalar implementation, the last one is the
+ * selected implementation.
+ */
+
+/** Returns the number of implementations supported by the CPU */
+unsigned nImplementations();
+
+/** Returns the name of the given implementation */
+const char* implementationName(unsigned implementation);
+
+/** `readTiles` using the given implementation */
+void readTilesWith(unsigned implementation, unsigned bitDepth,
+                   const uint8_t* planar, uint8_t* tiles, size_t count);
+
+/** `writeTiles` using the given implementation */
+void writeTilesWith(unsigned implementation, unsigned bitDepth,
+                    const uint8_t* tiles, uint8_t* planar, size_t count);
+}
+}
+}
+
+#endif
@@ -25,12 +25,26 @@ public:
     typedef std::array<uint8_t, TILE_DATA_SIZE> tileData_t;
 
 public:
+    // Does nothing if the tile is not completely inside the image.
     void drawTile(Image& imgage, const Palette<BIT_DEPTH>& palette,
                   unsigned xOffset, unsigned yOffset,
                   unsigned tileId, bool hFlip = false, bool vFlip = false) const;
 
+    // Draws the part of the tile that is inside the image.
+    void drawTileClipped(Image& image, const Palette<BIT_DEPTH>& palette,
+                         int xOffset, int yOffset,
+                         unsigned tileId, bool hFlip = false, bool vFlip = false) const;
+
     void addTile() { _tiles.emplace_back(); }
 
+    // Removes the tiles past the first `size` tiles
+    void truncate(size_t size)
+    {
+        if (size < _tiles.size()) {
+            _tiles.resize(size);
+        }
+    }
+
     size_t size() const { return _tiles.size(); }
 
     tileData_t& tile(size_t n) { return _tiles.at(n); }
@@ -57,6 +71,13 @@ public:
 
     void readSnesData(const std::vector<uint8_t>& data);
     std::vector<uint8_t> snesData() const;
+
+    /**
+     * Appends the tiles in the SNES data to the tileset.
+     *
+     * Any trailing partial tile is ignored.
+     */
+    void readSnesData(const uint8_t* data, size_t size);
 };
 
 /**
@@ -70,6 +91,13 @@ class Tileset16px : public Tileset<BIT_DEPTH, 16> {
 public:
     void readSnesData(const std::vector<uint8_t>& data);
     std::vector<uint8_t> snesData() const;
+
+    /**
+     * Appends the tiles in the SNES data to the tileset.
+     *
+     * Any trailing partial tile is ignored.
+     */
+    void readSnesData(const uint8_t* data, size_t size);
 };
 
 typedef Tileset8px<2> Tileset2bpp8px;
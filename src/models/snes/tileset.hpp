@@ -2,8 +2,15 @@
 #define _UNTECH_MODELS_SNES_TILESET_HPP_
 
 #include "tileset.h"
+#include "bitplanes.h"
+#include <algorithm>
 #include <cstring>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define UNTECH_TILESET_SSSE3
+#endif
+
 namespace UnTech {
 namespace Snes {
 
@@ -33,65 +40,221 @@ inline void _Tileset__insertTile16intoTile8(const uint8_t tile16[256], uint8_t t
     }
 }
 
+/*
+ * TILE DRAWING
+ * ============
+ *
+ * The flips are template parameters so the inner loops do not branch
+ * on them.
+ *
+ * Color 0 is transparent and the image pixel is left unchanged.
+ */
+
+// Palettes of 16 colors or less are copied into a lookup table (which
+// the SSSE3 code can load into registers). Larger palettes are read
+// directly as copying them costs more than drawing an 8px tile.
+template <size_t BIT_DEPTH, bool SMALL = (BIT_DEPTH <= 4)>
+struct _Tileset__PaletteLut {
+    alignas(16) std::array<uint32_t, 16> colors;
+
+    _Tileset__PaletteLut(const Palette<BIT_DEPTH>& palette)
+    {
+        colors.fill(0);
+        for (unsigned i = 0; i < palette.N_COLORS; i++) {
+            colors[i] = palette.color(i).rgb().value;
+        }
+    }
+
+    inline uint32_t color(unsigned i) const { return colors[i]; }
+};
+
 template <size_t BIT_DEPTH>
-void _Tileset__read8pxTile(const uint8_t* inData, uint8_t tile[64])
+struct _Tileset__PaletteLut<BIT_DEPTH, false> {
+    const Palette<BIT_DEPTH>& palette;
+
+    _Tileset__PaletteLut(const Palette<BIT_DEPTH>& p)
+        : palette(p)
+    {
+    }
+
+    inline uint32_t color(unsigned i) const { return palette.color(i).rgb().value; }
+};
+
+template <size_t BIT_DEPTH, size_t TILE_SIZE, bool H_FLIP, class LutT>
+inline void _Tileset__drawRowScalar(rgba* imgBits, const uint8_t* tileRow, const LutT& lut,
+                                    unsigned xStart, unsigned xEnd)
 {
-    const unsigned TILE_SIZE = 8;
+    constexpr unsigned PIXEL_MASK = (1 << BIT_DEPTH) - 1;
+
+    for (unsigned x = xStart; x < xEnd; x++) {
+        const unsigned p = tileRow[H_FLIP ? TILE_SIZE - 1 - x : x] & PIXEL_MASK;
 
-    static_assert(BIT_DEPTH <= 8, "BIT_DEPTH is too high");
-    static_assert((BIT_DEPTH & 1) == 0, "BIT_DEPTH must be a multiple of 2");
+        if (p != 0) {
+            imgBits[x].value = lut.color(p);
+        }
+    }
+}
 
-    const uint8_t* dataPos = inData;
-    memset(tile, 0, Tileset<BIT_DEPTH, 8>::TILE_DATA_SIZE);
+// Draws the part of the tile that is inside the image.
+//
+// `drawRow` is called for the rows that are completely inside the image.
+template <size_t BIT_DEPTH, size_t TILE_SIZE, bool H_FLIP, bool V_FLIP, class LutT, class DrawRowT>
+inline void _Tileset__drawTileRows(Image& image, const uint8_t* tile, const LutT& lut,
+                                   int xOffset, int yOffset, const DrawRowT& drawRow)
+{
+    const int width = image.size().width;
+    const int height = image.size().height;
 
-    for (unsigned b = 0; b < BIT_DEPTH; b += 2) {
-        for (unsigned y = 0; y < TILE_SIZE; y++) {
-            uint8_t* tileRow = tile + y * 8;
+    const unsigned xStart = xOffset < 0 ? -xOffset : 0;
+    const unsigned yStart = yOffset < 0 ? -yOffset : 0;
+    const unsigned xEnd = std::min<int>(TILE_SIZE, width - xOffset);
+    const unsigned yEnd = std::min<int>(TILE_SIZE, height - yOffset);
 
-            for (unsigned bi = 0; bi < 2; bi++) {
-                uint_fast8_t byte = *dataPos++;
-                uint_fast8_t bits = 1 << (b + bi);
+    const bool fullRow = xStart == 0 && xEnd == TILE_SIZE;
 
-                for (unsigned x = 0; x < TILE_SIZE; x++) {
-                    if (byte & 0x80) {
-                        tileRow[x] |= bits;
-                    }
-                    byte <<= 1;
-                }
-            }
+    for (unsigned y = yStart; y < yEnd; y++) {
+        const uint8_t* tileRow = tile + (V_FLIP ? TILE_SIZE - 1 - y : y) * TILE_SIZE;
+        rgba* imgBits = image.scanline(yOffset + y) + xOffset;
+
+        if (fullRow) {
+            drawRow(imgBits, tileRow);
+        }
+        else {
+            _Tileset__drawRowScalar<BIT_DEPTH, TILE_SIZE, H_FLIP>(imgBits, tileRow, lut, xStart, xEnd);
         }
     }
 }
 
-template <size_t BIT_DEPTH>
-void _Tileset__write8pxTile(const uint8_t tile[64], uint8_t* outData)
+template <size_t BIT_DEPTH, size_t TILE_SIZE, bool H_FLIP, bool V_FLIP, class LutT>
+void _Tileset__drawTileScalar(Image& image, const uint8_t* tile, const LutT& lut,
+                              int xOffset, int yOffset)
+{
+    _Tileset__drawTileRows<BIT_DEPTH, TILE_SIZE, H_FLIP, V_FLIP>(
+        image, tile, lut, xOffset, yOffset,
+        [&](rgba* imgBits, const uint8_t* tileRow) {
+            _Tileset__drawRowScalar<BIT_DEPTH, TILE_SIZE, H_FLIP>(imgBits, tileRow, lut, 0, TILE_SIZE);
+        });
+}
+
+/*
+ * SSSE3
+ * =====
+ *
+ * The palette is split into 4 tables (one per color channel) and pshufb
+ * looks up 8 pixels at a time. The transparent pixels are masked out
+ * before the row is stored.
+ */
+
+#ifdef UNTECH_TILESET_SSSE3
+
+// The implementation is selected once, on the first call.
+inline bool _Tileset__selectSsse3()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+
+inline bool _Tileset__useSsse3()
 {
-    const unsigned TILE_SIZE = 8;
+    static const bool useSsse3 = _Tileset__selectSsse3();
+    return useSsse3;
+}
+
+// Draws the 8 pixels at `tileRow` to `imgBits`.
+template <size_t BIT_DEPTH, bool H_FLIP>
+__attribute__((target("ssse3"))) inline void _Tileset__drawRow8Ssse3(rgba* imgBits, const uint8_t* tileRow,
+                                                                      const __m128i planes[4])
+{
+    __m128i idx = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(tileRow));
+    idx = _mm_and_si128(idx, _mm_set1_epi8((1 << BIT_DEPTH) - 1));
+
+    if (H_FLIP) {
+        idx = _mm_shuffle_epi8(idx, _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+                                                 0, 1, 2, 3, 4, 5, 6, 7));
+    }
 
-    static_assert(BIT_DEPTH <= 8, "BIT_DEPTH is too high");
-    static_assert((BIT_DEPTH & 1) == 0, "BIT_DEPTH must be a multiple of 2");
+    const __m128i rg = _mm_unpacklo_epi8(_mm_shuffle_epi8(planes[0], idx),
+                                         _mm_shuffle_epi8(planes[1], idx));
+    const __m128i ba = _mm_unpacklo_epi8(_mm_shuffle_epi8(planes[2], idx),
+                                         _mm_shuffle_epi8(planes[3], idx));
 
-    unsigned pos = 0;
-    memset(outData, 0, Tileset<BIT_DEPTH, 8>::SNES_DATA_SIZE);
+    const __m128i t = _mm_cmpeq_epi8(idx, _mm_setzero_si128());
+    const __m128i t16 = _mm_unpacklo_epi8(t, t);
 
-    for (unsigned b = 0; b < BIT_DEPTH; b += 2) {
-        for (unsigned y = 0; y < TILE_SIZE; y++) {
-            const uint8_t* tileRow = tile + y * 8;
+    __m128i* out = reinterpret_cast<__m128i*>(imgBits);
 
-            for (unsigned bi = 0; bi < 2; bi++) {
-                uint_fast8_t byte = 0;
-                uint_fast8_t mask = 1 << (b + bi);
+    const __m128i c0 = _mm_unpacklo_epi16(rg, ba);
+    const __m128i t0 = _mm_unpacklo_epi16(t16, t16);
+    const __m128i i0 = _mm_loadu_si128(out);
+    _mm_storeu_si128(out, _mm_or_si128(_mm_and_si128(t0, i0), _mm_andnot_si128(t0, c0)));
 
-                for (unsigned x = 0; x < TILE_SIZE; x++) {
-                    byte <<= 1;
+    const __m128i c1 = _mm_unpackhi_epi16(rg, ba);
+    const __m128i t1 = _mm_unpackhi_epi16(t16, t16);
+    const __m128i i1 = _mm_loadu_si128(out + 1);
+    _mm_storeu_si128(out + 1, _mm_or_si128(_mm_and_si128(t1, i1), _mm_andnot_si128(t1, c1)));
+}
 
-                    if (tileRow[x] & mask)
-                        byte |= 1;
-                }
-                outData[pos++] = byte;
+template <size_t BIT_DEPTH, size_t TILE_SIZE, bool H_FLIP, bool V_FLIP>
+__attribute__((target("ssse3"))) void _Tileset__drawTileSsse3(Image& image, const uint8_t* tile,
+                                                               const _Tileset__PaletteLut<BIT_DEPTH, true>& lut,
+                                                               int xOffset, int yOffset)
+{
+    static_assert(TILE_SIZE % 8 == 0, "Invalid TILE_SIZE");
+
+    // Transpose the 16 colors into the 4 channel tables.
+    const __m128i channelOrder = _mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0);
+    const __m128i* c = reinterpret_cast<const __m128i*>(lut.colors.data());
+
+    const __m128i s0 = _mm_shuffle_epi8(_mm_load_si128(c + 0), channelOrder);
+    const __m128i s1 = _mm_shuffle_epi8(_mm_load_si128(c + 1), channelOrder);
+    const __m128i s2 = _mm_shuffle_epi8(_mm_load_si128(c + 2), channelOrder);
+    const __m128i s3 = _mm_shuffle_epi8(_mm_load_si128(c + 3), channelOrder);
+
+    const __m128i rg0 = _mm_unpacklo_epi32(s0, s1);
+    const __m128i rg1 = _mm_unpacklo_epi32(s2, s3);
+    const __m128i ba0 = _mm_unpackhi_epi32(s0, s1);
+    const __m128i ba1 = _mm_unpackhi_epi32(s2, s3);
+
+    const __m128i planes[4] = {
+        _mm_unpacklo_epi64(rg0, rg1),
+        _mm_unpackhi_epi64(rg0, rg1),
+        _mm_unpacklo_epi64(ba0, ba1),
+        _mm_unpackhi_epi64(ba0, ba1),
+    };
+
+    _Tileset__drawTileRows<BIT_DEPTH, TILE_SIZE, H_FLIP, V_FLIP>(
+        image, tile, lut, xOffset, yOffset,
+        [&](rgba* imgBits, const uint8_t* tileRow) {
+            for (unsigned x = 0; x < TILE_SIZE; x += 8) {
+                const unsigned tx = H_FLIP ? TILE_SIZE - 8 - x : x;
+                _Tileset__drawRow8Ssse3<BIT_DEPTH, H_FLIP>(imgBits + x, tileRow + tx, planes);
             }
-        }
+        });
+}
+
+#endif
+
+template <size_t BIT_DEPTH, size_t TILE_SIZE, bool H_FLIP, bool V_FLIP>
+inline void _Tileset__drawTile(Image& image, const uint8_t* tile,
+                               const _Tileset__PaletteLut<BIT_DEPTH, true>& lut,
+                               int xOffset, int yOffset)
+{
+#ifdef UNTECH_TILESET_SSSE3
+    if (_Tileset__useSsse3()) {
+        _Tileset__drawTileSsse3<BIT_DEPTH, TILE_SIZE, H_FLIP, V_FLIP>(image, tile, lut, xOffset, yOffset);
+        return;
     }
+#endif
+
+    _Tileset__drawTileScalar<BIT_DEPTH, TILE_SIZE, H_FLIP, V_FLIP>(image, tile, lut, xOffset, yOffset);
+}
+
+template <size_t BIT_DEPTH, size_t TILE_SIZE, bool H_FLIP, bool V_FLIP>
+inline void _Tileset__drawTile(Image& image, const uint8_t* tile,
+                               const _Tileset__PaletteLut<BIT_DEPTH, false>& lut,
+                               int xOffset, int yOffset)
+{
+    _Tileset__drawTileScalar<BIT_DEPTH, TILE_SIZE, H_FLIP, V_FLIP>(image, tile, lut, xOffset, yOffset);
 }
 
 template <size_t BIT_DEPTH, size_t TILE_SIZE>
@@ -99,51 +262,47 @@ void Tileset<BIT_DEPTH, TILE_SIZE>::drawTile(Image& image, const Palette<BIT_DEP
                                              unsigned xOffset, unsigned yOffset,
                                              unsigned tileId, const bool hFlip, const bool vFlip) const
 {
-    if (_tiles.size() <= tileId
-        || image.size().width < (xOffset + TILE_SIZE)
+    if (image.size().width < (xOffset + TILE_SIZE)
         || image.size().height < (yOffset + TILE_SIZE)) {
 
         return;
     }
 
-    // ::SHOULDO refactor and profile to see if faster::
+    drawTileClipped(image, palette, xOffset, yOffset, tileId, hFlip, vFlip);
+}
+
+template <size_t BIT_DEPTH, size_t TILE_SIZE>
+void Tileset<BIT_DEPTH, TILE_SIZE>::drawTileClipped(Image& image, const Palette<BIT_DEPTH>& palette,
+                                                    int xOffset, int yOffset,
+                                                    unsigned tileId, const bool hFlip, const bool vFlip) const
+{
+    const int width = image.size().width;
+    const int height = image.size().height;
+
+    if (_tiles.size() <= tileId
+        || xOffset <= -int(TILE_SIZE) || xOffset >= width
+        || yOffset <= -int(TILE_SIZE) || yOffset >= height) {
+
+        return;
+    }
 
-    rgba* imgBits;
-    const uint8_t* tilePos = _tiles[tileId].data();
+    const _Tileset__PaletteLut<BIT_DEPTH> lut(palette);
+    const uint8_t* tile = _tiles[tileId].data();
 
-    for (unsigned y = 0; y < TILE_SIZE; y++) {
-        if (!hFlip) {
-            imgBits = image.scanline(yOffset + y);
+    if (!hFlip) {
+        if (!vFlip) {
+            _Tileset__drawTile<BIT_DEPTH, TILE_SIZE, false, false>(image, tile, lut, xOffset, yOffset);
         }
         else {
-            imgBits = image.scanline(yOffset + TILE_SIZE - y - 1);
+            _Tileset__drawTile<BIT_DEPTH, TILE_SIZE, false, true>(image, tile, lut, xOffset, yOffset);
         }
-
+    }
+    else {
         if (!vFlip) {
-            imgBits += xOffset;
-
-            for (unsigned x = 0; x < TILE_SIZE; x++) {
-                auto p = *tilePos & PIXEL_MASK;
-
-                if (p != 0) {
-                    *imgBits = palette.color(p).rgb();
-                }
-                imgBits++;
-                tilePos++;
-            }
+            _Tileset__drawTile<BIT_DEPTH, TILE_SIZE, true, false>(image, tile, lut, xOffset, yOffset);
         }
         else {
-            imgBits += xOffset + TILE_SIZE - 1;
-
-            for (unsigned x = 0; x < TILE_SIZE; x++) {
-                auto p = *tilePos & PIXEL_MASK;
-
-                if (p != 0) {
-                    *imgBits = palette.color(p).rgb();
-                }
-                imgBits--;
-                tilePos++;
-            }
+            _Tileset__drawTile<BIT_DEPTH, TILE_SIZE, true, true>(image, tile, lut, xOffset, yOffset);
         }
     }
 }
@@ -151,13 +310,13 @@ void Tileset<BIT_DEPTH, TILE_SIZE>::drawTile(Image& image, const Palette<BIT_DEP
 template <size_t BIT_DEPTH>
 inline std::vector<uint8_t> Tileset8px<BIT_DEPTH>::snesData() const
 {
-    std::vector<uint8_t> out(Tileset8px::SNES_DATA_SIZE * this->_tiles.size());
-    uint8_t* outData = out.data();
+    static_assert(sizeof(typename Tileset8px::tileData_t) == Tileset8px::TILE_DATA_SIZE,
+                  "tiles are not contiguous");
 
-    for (const auto& tile : this->_tiles) {
-        _Tileset__write8pxTile<BIT_DEPTH>(tile.data(), outData);
+    std::vector<uint8_t> out(Tileset8px::SNES_DATA_SIZE * this->_tiles.size());
 
-        outData += Tileset8px::SNES_DATA_SIZE;
+    if (!this->_tiles.empty()) {
+        Bitplanes::writeTiles(BIT_DEPTH, this->_tiles.front().data(), out.data(), this->_tiles.size());
     }
 
     return out;
@@ -171,26 +330,18 @@ inline std::vector<uint8_t> Tileset16px<BIT_DEPTH>::snesData() const
     std::vector<uint8_t> out(SNES_8_DATA_SIZE * 4 * this->_tiles.size());
     uint8_t* outData = out.data();
 
-    uint8_t tile8[8 * 8];
+    uint8_t tile8[4][8 * 8];
 
     for (const auto& tile : this->_tiles) {
         const uint8_t* tile16 = tile.data();
 
-        _Tileset__insertTile16intoTile8(tile16, tile8, 0, 0);
-        _Tileset__write8pxTile<BIT_DEPTH>(tile8, outData);
-        outData += SNES_8_DATA_SIZE;
-
-        _Tileset__insertTile16intoTile8(tile16, tile8, 8, 0);
-        _Tileset__write8pxTile<BIT_DEPTH>(tile8, outData);
-        outData += SNES_8_DATA_SIZE;
-
-        _Tileset__insertTile16intoTile8(tile16, tile8, 0, 8);
-        _Tileset__write8pxTile<BIT_DEPTH>(tile8, outData);
-        outData += SNES_8_DATA_SIZE;
+        _Tileset__insertTile16intoTile8(tile16, tile8[0], 0, 0);
+        _Tileset__insertTile16intoTile8(tile16, tile8[1], 8, 0);
+        _Tileset__insertTile16intoTile8(tile16, tile8[2], 0, 8);
+        _Tileset__insertTile16intoTile8(tile16, tile8[3], 8, 8);
 
-        _Tileset__insertTile16intoTile8(tile16, tile8, 8, 8);
-        _Tileset__write8pxTile<BIT_DEPTH>(tile8, outData);
-        outData += SNES_8_DATA_SIZE;
+        Bitplanes::writeTiles(BIT_DEPTH, tile8[0], outData, 4);
+        outData += SNES_8_DATA_SIZE * 4;
     }
 
     return out;
@@ -199,48 +350,54 @@ inline std::vector<uint8_t> Tileset16px<BIT_DEPTH>::snesData() const
 template <size_t BIT_DEPTH>
 inline void Tileset8px<BIT_DEPTH>::readSnesData(const std::vector<uint8_t>& in)
 {
-    const uint8_t* inData = in.data();
-    size_t count = in.size() / Tileset8px::SNES_DATA_SIZE;
-
-    for (size_t i = 0; i < count; i++) {
-        this->addTile();
-        uint8_t* tile = this->_tiles.back().data();
+    readSnesData(in.data(), in.size());
+}
 
-        _Tileset__read8pxTile<BIT_DEPTH>(inData, tile);
+template <size_t BIT_DEPTH>
+inline void Tileset8px<BIT_DEPTH>::readSnesData(const uint8_t* data, size_t size)
+{
+    static_assert(sizeof(typename Tileset8px::tileData_t) == Tileset8px::TILE_DATA_SIZE,
+                  "tiles are not contiguous");
 
-        inData += Tileset8px::SNES_DATA_SIZE;
+    size_t count = size / Tileset8px::SNES_DATA_SIZE;
+    if (count == 0) {
+        return;
     }
+
+    const size_t first = this->_tiles.size();
+    this->_tiles.resize(first + count);
+
+    Bitplanes::readTiles(BIT_DEPTH, data, this->_tiles[first].data(), count);
 }
 
 template <size_t BIT_DEPTH>
 inline void Tileset16px<BIT_DEPTH>::readSnesData(const std::vector<uint8_t>& in)
+{
+    readSnesData(in.data(), in.size());
+}
+
+template <size_t BIT_DEPTH>
+inline void Tileset16px<BIT_DEPTH>::readSnesData(const uint8_t* inData, size_t size)
 {
     const size_t SNES_8_DATA_SIZE = Tileset8px<BIT_DEPTH>::SNES_DATA_SIZE;
 
-    const uint8_t* inData = in.data();
-    size_t count = in.size() / Tileset16px::SNES_DATA_SIZE;
+    size_t count = size / Tileset16px::SNES_DATA_SIZE;
+
+    this->_tiles.reserve(this->_tiles.size() + count);
 
-    uint8_t tile8[8 * 8];
+    uint8_t tile8[4][8 * 8];
 
     for (size_t i = 0; i < count; i++) {
         this->addTile();
         uint8_t* tile16 = this->_tiles.back().data();
 
-        _Tileset__read8pxTile<BIT_DEPTH>(inData, tile8);
-        _Tileset__insertTile8intoTile16(tile8, tile16, 0, 0);
-        inData += SNES_8_DATA_SIZE;
-
-        _Tileset__read8pxTile<BIT_DEPTH>(inData, tile8);
-        _Tileset__insertTile8intoTile16(tile8, tile16, 8, 0);
-        inData += SNES_8_DATA_SIZE;
-
-        _Tileset__read8pxTile<BIT_DEPTH>(inData, tile8);
-        _Tileset__insertTile8intoTile16(tile8, tile16, 0, 8);
-        inData += SNES_8_DATA_SIZE;
+        Bitplanes::readTiles(BIT_DEPTH, inData, tile8[0], 4);
+        inData += SNES_8_DATA_SIZE * 4;
 
-        _Tileset__read8pxTile<BIT_DEPTH>(inData, tile8);
-        _Tileset__insertTile8intoTile16(tile8, tile16, 8, 8);
-        inData += SNES_8_DATA_SIZE;
+        _Tileset__insertTile8intoTile16(tile8[0], tile16, 0, 0);
+        _Tileset__insertTile8intoTile16(tile8[1], tile16, 8, 0);
+        _Tileset__insertTile8intoTile16(tile8[2], tile16, 0, 8);
+        _Tileset__insertTile8intoTile16(tile8[3], tile16, 8, 8);
     }
 }
 }
@@ -0,0 +1,393 @@
+#include "frameobjectcover.h"
+#include "frameset.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace UnTech;
+using namespace UnTech::SpriteImporter;
+
+FrameObjectCover::tile_t
+FrameObjectCover::canonicalTile(const Frame& frame, const upoint& location, unsigned size)
+{
+    const Image& image = frame.frameSet().image();
+
+    const unsigned xOffset = frame.location().x + location.x;
+    const unsigned yOffset = frame.location().y + location.y;
+
+    tile_t tile(size * size);
+    for (unsigned y = 0; y < size; y++) {
+        const rgba* imgBits = image.scanline(yOffset + y) + xOffset;
+
+        for (unsigned x = 0; x < size; x++) {
+            tile[y * size + x] = imgBits[x].value;
+        }
+    }
+
+    tile_t canonical = tile;
+    tile_t flipped(size * size);
+
+    for (unsigned f = 1; f < 4; f++) {
+        const unsigned xMask = (f & 1) ? size - 1 : 0;
+        const unsigned yMask = (f & 2) ? size - 1 : 0;
+
+        for (unsigned y = 0; y < size; y++) {
+            for (unsigned x = 0; x < size; x++) {
+                flipped[y * size + x] = tile[(y ^ yMask) * size + (x ^ xMask)];
+            }
+        }
+
+        if (flipped < canonical) {
+            canonical = flipped;
+        }
+    }
+
+    return canonical;
+}
+
+std::vector<urect>
+FrameObjectCover::gridCover(const std::vector<bool>& opaque, unsigned width, unsigned height)
+{
+    const unsigned SMALL = static_cast<unsigned>(FrameObject::ObjectSize::SMALL);
+    const unsigned LARGE = static_cast<unsigned>(FrameObject::ObjectSize::LARGE);
+
+    std::vector<urect> ret;
+
+    if (width < SMALL || height < SMALL) {
+        return ret;
+    }
+    const unsigned cellSize = (width >= LARGE && height >= LARGE) ? LARGE : SMALL;
+
+    // bounding box of the opaque pixels
+    unsigned left = width, right = 0, top = height, bottom = 0;
+    for (unsigned y = 0; y < height; y++) {
+        for (unsigned x = 0; x < width; x++) {
+            if (opaque[y * width + x]) {
+                left = std::min(left, x);
+                right = std::max(right, x + 1);
+                top = std::min(top, y);
+                bottom = std::max(bottom, y + 1);
+            }
+        }
+    }
+
+    for (unsigned cy = top; cy < bottom; cy += cellSize) {
+        for (unsigned cx = left; cx < right; cx += cellSize) {
+            const unsigned cRight = std::min(cx + cellSize, right);
+            const unsigned cBottom = std::min(cy + cellSize, bottom);
+
+            // bounding box of the opaque pixels in the cell
+            unsigned l = cRight, r = cx, t = cBottom, b = cy;
+            for (unsigned y = cy; y < cBottom; y++) {
+                for (unsigned x = cx; x < cRight; x++) {
+                    if (opaque[y * width + x]) {
+                        l = std::min(l, x);
+                        r = std::max(r, x + 1);
+                        t = std::min(t, y);
+                        b = std::max(b, y + 1);
+                    }
+                }
+            }
+            if (l >= r) {
+                continue;
+            }
+
+            // Objects past the edge of the frame are moved inside it, the
+            // opaque pixels of the cell are still covered.
+            const unsigned size = (r - l <= SMALL && b - t <= SMALL) ? SMALL : cellSize;
+            ret.emplace_back(std::min(l, width - size), std::min(t, height - size), size, size);
+        }
+    }
+
+    return ret;
+}
+
+void FrameObjectCover::addFrameTiles(const Frame& frame)
+{
+    const Image& image = frame.frameSet().image();
+
+    if (image.empty() || !image.size().contains(frame.location())) {
+        return;
+    }
+
+    for (const FrameObject& obj : frame.objects()) {
+        _tiles.insert(canonicalTile(frame, obj.location(), obj.sizePx()));
+    }
+}
+
+std::vector<FrameObjectCover::Object> FrameObjectCover::process(const Frame& frame)
+{
+    FrameSet& frameSet = frame.frameSet();
+    const Image& image = frameSet.image();
+    const urect frameLocation = frame.location();
+
+    if (image.empty() || !image.size().contains(frameLocation)) {
+        throw std::runtime_error("Frame not inside image");
+    }
+
+    const unsigned width = frameLocation.width;
+    const unsigned height = frameLocation.height;
+    const rgba transparent = frameSet.transparentColor();
+
+    std::vector<bool> opaque(width * height);
+    for (unsigned y = 0; y < height; y++) {
+        const rgba* imgBits = image.scanline(frameLocation.y + y) + frameLocation.x;
+
+        for (unsigned x = 0; x < width; x++) {
+            opaque[y * width + x] = imgBits[x] != transparent;
+        }
+    }
+    std::vector<bool> uncovered = opaque;
+
+    struct Candidate {
+        urect rect;
+        unsigned nPixels;
+        bool overlaps;
+        bool knownTile;
+        tile_t tile;
+    };
+
+    std::vector<Candidate> placed;
+    std::set<tile_t> frameTiles;
+
+    auto isBetter = [](const Candidate& c, const Candidate& best) {
+        if (c.nPixels != best.nPixels) {
+            return c.nPixels > best.nPixels;
+        }
+        if (c.overlaps != best.overlaps) {
+            return !c.overlaps;
+        }
+        if (c.knownTile != best.knownTile) {
+            return c.knownTile;
+        }
+        if (c.rect.width != best.rect.width) {
+            return c.rect.width < best.rect.width;
+        }
+        // scan order, so solid areas are tiled without slivers
+        if (c.rect.y != best.rect.y) {
+            return c.rect.y < best.rect.y;
+        }
+        return c.rect.x < best.rect.x;
+    };
+
+    while (std::any_of(uncovered.begin(), uncovered.end(), [](bool b) { return b; })) {
+        // summed area table of the uncovered pixels
+        std::vector<unsigned> sat((width + 1) * (height + 1), 0);
+        for (unsigned y = 0; y < height; y++) {
+            for (unsigned x = 0; x < width; x++) {
+                sat[(y + 1) * (width + 1) + x + 1] = uncovered[y * width + x]
+                                                     + sat[y * (width + 1) + x + 1]
+                                                     + sat[(y + 1) * (width + 1) + x]
+                                                     - sat[y * (width + 1) + x];
+            }
+        }
+        auto countUncovered = [&](const urect& r) {
+            return sat[r.bottom() * (width + 1) + r.right()]
+                   - sat[r.top() * (width + 1) + r.right()]
+                   - sat[r.bottom() * (width + 1) + r.left()]
+                   + sat[r.top() * (width + 1) + r.left()];
+        };
+
+        Candidate best;
+        bool hasBest = false;
+
+        for (const auto objSize : { FrameObject::ObjectSize::LARGE, FrameObject::ObjectSize::SMALL }) {
+            const unsigned size = static_cast<unsigned>(objSize);
+
+            if (size > width || size > height) {
+                continue;
+            }
+
+            for (unsigned y = 0; y <= height - size; y++) {
+                for (unsigned x = 0; x <= width - size; x++) {
+                    Candidate c;
+                    c.rect = urect(x, y, size, size);
+                    c.nPixels = countUncovered(c.rect);
+
+                    if (c.nPixels == 0 || (hasBest && c.nPixels < best.nPixels)) {
+                        continue;
+                    }
+
+                    c.overlaps = std::any_of(placed.begin(), placed.end(),
+                                             [&](const Candidate& p) { return p.rect.overlaps(c.rect); });
+                    c.tile = canonicalTile(frame, upoint(x, y), size);
+                    c.knownTile = _tiles.count(c.tile) > 0 || frameTiles.count(c.tile) > 0;
+
+                    if (!hasBest || isBetter(c, best)) {
+                        best = std::move(c);
+                        hasBest = true;
+                    }
+                }
+            }
+        }
+
+        if (!hasBest) {
+            throw std::runtime_error("Frame is too small");
+        }
+
+        for (unsigned y = best.rect.top(); y < best.rect.bottom(); y++) {
+            for (unsigned x = best.rect.left(); x < best.rect.right(); x++) {
+                uncovered[y * width + x] = false;
+            }
+        }
+
+        frameTiles.insert(best.tile);
+        placed.push_back(std::move(best));
+    }
+
+    // The greedy cover can place more objects than a grid aligned to the
+    // opaque pixels, use the grid if it is smaller.
+    {
+        const std::vector<urect> grid = gridCover(opaque, width, height);
+
+        if (!grid.empty() && grid.size() < placed.size()) {
+            placed.clear();
+
+            for (const urect& r : grid) {
+                Candidate c;
+                c.rect = r;
+                c.tile = canonicalTile(frame, upoint(r.x, r.y), r.width);
+                placed.push_back(std::move(c));
+            }
+        }
+    }
+
+    // Remove the objects whose pixels are all covered by the other objects
+    for (size_t i = 0; i < placed.size();) {
+        std::vector<bool> covered(width * height, false);
+
+        for (size_t j = 0; j < placed.size(); j++) {
+            if (j != i) {
+                const urect& r = placed[j].rect;
+
+                for (unsigned y = r.top(); y < r.bottom(); y++) {
+                    for (unsigned x = r.left(); x < r.right(); x++) {
+                        covered[y * width + x] = true;
+                    }
+                }
+            }
+        }
+
+        const urect& r = placed[i].rect;
+        bool redundant = true;
+
+        for (unsigned y = r.top(); y < r.bottom() && redundant; y++) {
+            for (unsigned x = r.left(); x < r.right(); x++) {
+                if (opaque[y * width + x] && !covered[y * width + x]) {
+                    redundant = false;
+                    break;
+                }
+            }
+        }
+
+        if (redundant) {
+            placed.erase(placed.begin() + i);
+        }
+        else {
+            i++;
+        }
+    }
+
+    // Move (or shrink) each object to reuse a known tile, if possible,
+    // without uncovering any pixels.
+    for (size_t i = 0; i < placed.size(); i++) {
+        std::vector<bool> covered(width * height, false);
+
+        for (size_t j = 0; j < placed.size(); j++) {
+            if (j != i) {
+                const urect& r = placed[j].rect;
+
+                for (unsigned y = r.top(); y < r.bottom(); y++) {
+                    for (unsigned x = r.left(); x < r.right(); x++) {
+                        covered[y * width + x] = true;
+                    }
+                }
+            }
+        }
+
+        // bounding box of the pixels only covered by this object
+        const urect& r = placed[i].rect;
+        unsigned left = r.right(), right = r.left(), top = r.bottom(), bottom = r.top();
+
+        for (unsigned y = r.top(); y < r.bottom(); y++) {
+            for (unsigned x = r.left(); x < r.right(); x++) {
+                if (opaque[y * width + x] && !covered[y * width + x]) {
+                    left = std::min(left, x);
+                    right = std::max(right, x + 1);
+                    top = std::min(top, y);
+                    bottom = std::max(bottom, y + 1);
+                }
+            }
+        }
+
+        auto isKnown = [&](const tile_t& tile) {
+            if (_tiles.count(tile) > 0) {
+                return true;
+            }
+            for (size_t j = 0; j < placed.size(); j++) {
+                if (j != i && placed[j].tile == tile) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        Candidate& best = placed[i];
+        best.knownTile = isKnown(best.tile);
+
+        for (const auto objSize : { FrameObject::ObjectSize::SMALL, FrameObject::ObjectSize::LARGE }) {
+            const unsigned size = static_cast<unsigned>(objSize);
+
+            if (size > width || size > height || right - left > size || bottom - top > size) {
+                continue;
+            }
+
+            const unsigned minX = right > size ? right - size : 0;
+            const unsigned maxX = std::min(left, width - size);
+            const unsigned minY = bottom > size ? bottom - size : 0;
+            const unsigned maxY = std::min(top, height - size);
+
+            for (unsigned y = minY; y <= maxY; y++) {
+                for (unsigned x = minX; x <= maxX; x++) {
+                    const tile_t tile = canonicalTile(frame, upoint(x, y), size);
+                    const bool known = isKnown(tile);
+
+                    if ((known && !best.knownTile)
+                        || (known == best.knownTile && size < best.rect.width)) {
+
+                        best.rect = urect(x, y, size, size);
+                        best.tile = tile;
+                        best.knownTile = known;
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<Object> ret;
+    ret.reserve(placed.size());
+
+    for (const Candidate& c : placed) {
+        _tiles.insert(c.tile);
+
+        ret.push_back({ upoint(c.rect.x, c.rect.y),
+                        static_cast<FrameObject::ObjectSize>(c.rect.width) });
+    }
+
+    return ret;
+}
+
+void FrameObjectCover::apply(Frame& frame)
+{
+    const std::vector<Object> objects = process(frame);
+
+    while (frame.objects().size() > 0) {
+        frame.objects().remove(&frame.objects().at(0));
+    }
+
+    for (const Object& o : objects) {
+        FrameObject& obj = frame.objects().create();
+
+        obj.setSize(o.size);
+        obj.setLocation(o.location);
+    }
+}
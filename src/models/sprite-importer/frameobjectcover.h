@@ -0,0 +1,81 @@
+#ifndef _UNTECH_MODELS_SPRITEIMPORTER_FRAMEOBJECTCOVER_H_
+#define _UNTECH_MODELS_SPRITEIMPORTER_FRAMEOBJECTCOVER_H_
+
+#include "frame.h"
+#include "frameobject.h"
+#include "../common/aabb.h"
+#include <cstdint>
+#include <set>
+#include <vector>
+
+namespace UnTech {
+namespace SpriteImporter {
+
+/**
+ * Generates the frame objects that cover the non-transparent pixels
+ * of a frame.
+ *
+ * The number of objects is minimized first, then the number of unique
+ * tiles. Tiles that have already been used (in any orientation) by the
+ * previously processed frames are preferred.
+ *
+ * The cover is built greedily, each step places the object that covers
+ * the most uncovered pixels (ties prefer objects that do not overlap the
+ * placed objects, known tiles, small objects and then scan order). If a
+ * grid of objects aligned to the opaque pixels needs fewer objects the
+ * grid is used instead. Then objects that are made redundant by the others
+ * are removed and the remaining objects are moved (or shrunk) onto known
+ * tiles where that does not uncover a pixel.
+ */
+class FrameObjectCover {
+public:
+    struct Object {
+        upoint location;
+        FrameObject::ObjectSize size;
+    };
+
+public:
+    FrameObjectCover() = default;
+
+    /**
+     * Adds the tiles of the frame's existing objects to the set of
+     * known tiles.
+     */
+    void addFrameTiles(const Frame& frame);
+
+    /**
+     * Calculates the objects that cover the frame and adds their tiles
+     * to the set of known tiles.
+     *
+     * The frame is not modified.
+     *
+     * Throws a std::runtime_error if the frame is not inside the image.
+     */
+    std::vector<Object> process(const Frame& frame);
+
+    /**
+     * Replaces the objects of the frame with the objects returned by
+     * `process`.
+     */
+    void apply(Frame& frame);
+
+    size_t nTiles() const { return _tiles.size(); }
+
+private:
+    // the pixels of the tile in its lexicographically smallest orientation
+    typedef std::vector<uint32_t> tile_t;
+
+    static tile_t canonicalTile(const Frame& frame, const upoint& location, unsigned size);
+
+    // One object per grid cell, the grid is aligned to the top left of the
+    // opaque pixels.
+    static std::vector<urect> gridCover(const std::vector<bool>& opaque,
+                                        unsigned width, unsigned height);
+
+private:
+    std::set<tile_t> _tiles;
+};
+}
+}
+
+#endif
@@ -339,6 +339,13 @@ void readFile(FrameSet& frameSet, const std::string& filename)
     reader.readFrameSet(tag.get());
 }
 
+void writeFile(const FrameSet& frameSet, std::ostream& file)
+{
+    XmlWriter xml(file, "untech");
+
+    FrameSetWriter::writeFrameSet(xml, frameSet);
+}
+
 void writeFile(const FrameSet& frameSet, const std::string& filename)
 {
     UnTech::AtomicOfStream file(filename);
@@ -28,6 +28,8 @@ namespace Serializer {
 // NOTE: FrameSet MUST be empty
 void readFile(FrameSet& frameSet, const std::string& filename);
 
+void writeFile(const FrameSet& frameSet, std::ostream& file);
+
 void writeFile(const FrameSet& frameSet, const std::string& filename);
 }
 }
@@ -0,0 +1,215 @@
+#ifndef _UNTECH_MODELS_UTSI2UTMS_OVERLAPPEDTILEINDEX_H_
+#define _UNTECH_MODELS_UTSI2UTMS_OVERLAPPEDTILEINDEX_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace UnTech {
+namespace Utsi2UtmsPrivate {
+
+/**
+ * A search index for the partially overlapped tile matcher.
+ *
+ * An under tile matches a tileset tile if every pixel that is not
+ * overlapped is equal. The best match is the one with the most equal
+ * pixels.
+ *
+ * The tiles are stored in two bitmask forms:
+ *
+ *  - An inverted index that holds, for every pixel and color, a bitmask
+ *    of the tiles (64 tiles per block) that have that color at that pixel.
+ *    ANDing the masks of the non-overlapped pixels of the query gives the
+ *    matching tiles of a block, without touching the tiles themselves.
+ *
+ *  - A signature for each tile, containing one bitmask per color. Equal
+ *    pixels are counted 64 pixels at a time by ANDing the query and tile
+ *    signatures.
+ *
+ * Only unflipped tiles are indexed. A flipped tile is matched by flipping
+ * the query.
+ */
+template <unsigned TILE_SIZE, unsigned N_COLORS>
+class OverlappedTileIndex {
+    static_assert((N_COLORS & (N_COLORS - 1)) == 0, "N_COLORS must be a power of 2");
+
+public:
+    constexpr static unsigned TILE_DATA_SIZE = TILE_SIZE * TILE_SIZE;
+
+    typedef std::array<uint8_t, TILE_DATA_SIZE> tileData_t;
+    typedef std::array<bool, TILE_DATA_SIZE> overlaps_t;
+
+    struct Match {
+        unsigned tileId;
+        bool hFlip;
+        bool vFlip;
+
+        // number of equal pixels, 0 if no match was found
+        unsigned score;
+    };
+
+private:
+    constexpr static unsigned BLOCK_SIZE = 64;
+    constexpr static unsigned N_WORDS = (TILE_DATA_SIZE + 63) / 64;
+
+    // [color][word]
+    typedef std::array<uint64_t, N_COLORS * N_WORDS> signature_t;
+
+    // [pixel][color], one bit per tile in the block
+    typedef std::array<uint64_t, TILE_DATA_SIZE * N_COLORS> indexBlock_t;
+
+public:
+    OverlappedTileIndex() = default;
+
+    size_t size() const { return _signatures.size(); }
+
+    void addTile(const tileData_t& tile)
+    {
+        const size_t tileId = _signatures.size();
+
+        if (tileId % BLOCK_SIZE == 0) {
+            _blocks.emplace_back();
+            _blocks.back().fill(0);
+        }
+
+        indexBlock_t& block = _blocks.back();
+        const uint64_t tileBit = uint64_t(1) << (tileId % BLOCK_SIZE);
+
+        for (unsigned i = 0; i < TILE_DATA_SIZE; i++) {
+            block[i * N_COLORS + (tile[i] & (N_COLORS - 1))] |= tileBit;
+        }
+
+        _signatures.push_back(buildSignature(tile));
+    }
+
+    /**
+     * Returns the tile and flips with the most equal pixels, where every
+     * pixel that is not overlapped is equal.
+     *
+     * If two matches have the same score the lowest tileId is used, then
+     * the first flip in the order: none, hFlip, vFlip, hFlip and vFlip.
+     */
+    Match findBestMatch(const tileData_t& underTile, const overlaps_t& overlaps) const
+    {
+        Match best = { 0, false, false, 0 };
+        unsigned bestFlip = 0;
+
+        for (unsigned f = 0; f < 4; f++) {
+            const bool hFlip = f & 1;
+            const bool vFlip = f & 2;
+
+            // flip(tile) matches underTile if tile matches flip(underTile)
+            const unsigned xMask = hFlip ? TILE_SIZE - 1 : 0;
+            const unsigned yMask = vFlip ? TILE_SIZE - 1 : 0;
+
+            tileData_t query;
+            std::array<uint16_t, TILE_DATA_SIZE> keys;
+            unsigned nKeys = 0;
+            unsigned nTransparentKeys = 0;
+
+            for (unsigned y = 0; y < TILE_SIZE; y++) {
+                for (unsigned x = 0; x < TILE_SIZE; x++) {
+                    const unsigned i = y * TILE_SIZE + x;
+                    const unsigned u = (y ^ yMask) * TILE_SIZE + (x ^ xMask);
+
+                    const uint8_t c = underTile[u] & (N_COLORS - 1);
+                    query[i] = c;
+
+                    if (overlaps[u] == false) {
+                        // Transparent pixels are the least selective,
+                        // they are tested last.
+                        if (c != 0) {
+                            keys[nKeys++] = i * N_COLORS + c;
+                        }
+                        else {
+                            keys[TILE_DATA_SIZE - 1 - nTransparentKeys++] = i * N_COLORS;
+                        }
+                    }
+                }
+            }
+            std::copy(keys.end() - nTransparentKeys, keys.end(), keys.begin() + nKeys);
+            nKeys += nTransparentKeys;
+
+            const signature_t querySignature = buildSignature(query);
+
+            unsigned queryColors = 0;
+            for (unsigned c = 0; c < N_COLORS; c++) {
+                for (unsigned w = 0; w < N_WORDS; w++) {
+                    if (querySignature[c * N_WORDS + w]) {
+                        queryColors |= 1 << c;
+                    }
+                }
+            }
+
+            for (size_t b = 0; b < _blocks.size(); b++) {
+                const indexBlock_t& block = _blocks[b];
+
+                const size_t nInBlock = std::min<size_t>(_signatures.size() - b * BLOCK_SIZE, BLOCK_SIZE);
+                uint64_t candidates = nInBlock < 64 ? (uint64_t(1) << nInBlock) - 1 : ~uint64_t(0);
+
+                for (unsigned k = 0; k < nKeys && candidates; k++) {
+                    candidates &= block[keys[k]];
+                }
+
+                while (candidates) {
+                    const unsigned bit = __builtin_ctzll(candidates);
+                    candidates &= candidates - 1;
+
+                    const unsigned tileId = b * BLOCK_SIZE + bit;
+                    const unsigned score = countEqualPixels(_signatures[tileId], querySignature, queryColors);
+
+                    if (score > best.score
+                        || (score == best.score && score > 0
+                            && (tileId < best.tileId || (tileId == best.tileId && f < bestFlip)))) {
+
+                        best = { tileId, hFlip, vFlip, score };
+                        bestFlip = f;
+                    }
+                }
+            }
+        }
+
+        return best;
+    }
+
+private:
+    static signature_t buildSignature(const tileData_t& tile)
+    {
+        signature_t sig = {};
+
+        for (unsigned i = 0; i < TILE_DATA_SIZE; i++) {
+            const unsigned c = tile[i] & (N_COLORS - 1);
+            sig[c * N_WORDS + i / 64] |= uint64_t(1) << (i % 64);
+        }
+
+        return sig;
+    }
+
+    static unsigned countEqualPixels(const signature_t& tile, const signature_t& query,
+                                     unsigned queryColors)
+    {
+        unsigned score = 0;
+
+        for (unsigned w = 0; w < N_WORDS; w++) {
+            uint64_t equal = 0;
+
+            for (unsigned colors = queryColors; colors; colors &= colors - 1) {
+                const unsigned c = __builtin_ctz(colors);
+                equal |= tile[c * N_WORDS + w] & query[c * N_WORDS + w];
+            }
+
+            score += __builtin_popcountll(equal);
+        }
+
+        return score;
+    }
+
+private:
+    std::vector<signature_t> _signatures;
+    std::vector<indexBlock_t> _blocks;
+};
+}
+}
+
+#endif
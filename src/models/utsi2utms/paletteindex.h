@@ -0,0 +1,111 @@
+#ifndef _UNTECH_MODELS_UTSI2UTMS_PALETTEINDEX_H_
+#define _UNTECH_MODELS_UTSI2UTMS_PALETTEINDEX_H_
+
+#include "../common/rgba.h"
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace UnTech {
+namespace Utsi2UtmsPrivate {
+
+/**
+ * A small flat rgba -> palette index lookup table.
+ *
+ * Used instead of a std::map as it is called once per pixel.
+ * The colors are compared 4 at a time (if SSE2 is available).
+ */
+class PaletteIndex {
+public:
+    const static unsigned MAX_COLORS = 16;
+
+public:
+    PaletteIndex()
+        : _size(0)
+    {
+        _colors.fill(0);
+    }
+
+    inline unsigned size() const { return _size; }
+    inline bool full() const { return _size >= MAX_COLORS; }
+
+    inline rgba color(unsigned i) const { return _colors.at(i); }
+
+    /** returns -1 if color is not in the index */
+    inline int find(const rgba color) const
+    {
+#ifdef __SSE2__
+        const __m128i c = _mm_set1_epi32(color.value);
+        const __m128i* p = reinterpret_cast<const __m128i*>(_colors.data());
+
+        unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(c, _mm_load_si128(p + 0))))
+                        | _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(c, _mm_load_si128(p + 1)))) << 4
+                        | _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(c, _mm_load_si128(p + 2)))) << 8
+                        | _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(c, _mm_load_si128(p + 3)))) << 12;
+
+        // ignore unused entries
+        mask &= (1U << _size) - 1;
+
+        if (mask) {
+            return __builtin_ctz(mask);
+        }
+        return -1;
+#else
+        for (unsigned i = 0; i < _size; i++) {
+            if (_colors[i] == color.value) {
+                return i;
+            }
+        }
+        return -1;
+#endif
+    }
+
+    /**
+     * Adds the color to the index if it does not already exist.
+     *
+     * Returns false if the index is full.
+     */
+    inline bool insert(const rgba color)
+    {
+        if (find(color) >= 0) {
+            return true;
+        }
+        if (full()) {
+            return false;
+        }
+
+        _colors[_size] = color.value;
+        _size++;
+
+        return true;
+    }
+
+    /**
+     * Returns the palette index of the color.
+     *
+     * Throws std::out_of_range if the color is not in the palette.
+     */
+    inline uint8_t at(const rgba color) const
+    {
+        int i = find(color);
+
+        if (i < 0) {
+            throw std::out_of_range("Color not in palette");
+        }
+        return i;
+    }
+
+private:
+    static_assert(MAX_COLORS == 16, "find() expects 16 colors");
+
+    alignas(16) std::array<uint32_t, MAX_COLORS> _colors;
+    unsigned _size;
+};
+}
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include "sharedtilepool.h"
+#include "models/metasprite.h"
+#include "models/sprite-importer.h"
+#include <stdexcept>
+#include <vector>
+
+namespace UnTech {
+namespace Utsi2UtmsPrivate {
+
+namespace MS = UnTech::MetaSprite;
+
+template <class TilesetT>
+void checkTileIds(const TilesetT& tileset, const std::vector<const MS::FrameObject*>& objects)
+{
+    for (const MS::FrameObject* obj : objects) {
+        if (obj->tileId() >= tileset.size()) {
+            throw std::runtime_error("Frame object tileId is out of range");
+        }
+    }
+}
+
+template <class TilesetT>
+void addTilesToPool(TilesetInserter<TilesetT>& inserter, const TilesetT& pool,
+                    const TilesetT& tileset, const std::vector<const MS::FrameObject*>& objects,
+                    std::vector<SharedTilePool::PoolTile>& tileMap,
+                    unsigned& nTiles, unsigned& nNewTiles)
+{
+    const unsigned poolSize = pool.size();
+
+    tileMap.assign(tileset.size(), SharedTilePool::PoolTile());
+
+    for (const MS::FrameObject* obj : objects) {
+        SharedTilePool::PoolTile& pt = tileMap[obj->tileId()];
+
+        if (!pt.used) {
+            const TilesetInserterOutput to = inserter.getOrInsert(tileset.tile(obj->tileId()));
+
+            pt.used = true;
+            pt.tileId = to.tileId;
+            pt.hFlip = to.hFlip;
+            pt.vFlip = to.vFlip;
+
+            nTiles++;
+        }
+    }
+
+    nNewTiles = pool.size() - poolSize;
+}
+}
+}
+
+using namespace UnTech;
+using namespace UnTech::Utsi2UtmsPrivate;
+
+unsigned SharedTilePool::Statistics::romBytesBefore() const
+{
+    return nSmallTilesBefore * Snes::Tileset4bpp8px::SNES_DATA_SIZE
+           + nLargeTilesBefore * Snes::Tileset4bpp16px::SNES_DATA_SIZE;
+}
+
+unsigned SharedTilePool::Statistics::romBytesAfter() const
+{
+    return nSmallTiles * Snes::Tileset4bpp8px::SNES_DATA_SIZE
+           + nLargeTiles * Snes::Tileset4bpp16px::SNES_DATA_SIZE;
+}
+
+SharedTilePool::SharedTilePool()
+    : _smallTileset()
+    , _largeTileset()
+    , _smallInserter(_smallTileset)
+    , _largeInserter(_largeTileset)
+    , _tileMaps()
+    , _statistics()
+{
+}
+
+SharedTilePool::FrameSetStatistics SharedTilePool::addFrameSet(const MS::FrameSet& frameSet)
+{
+    std::vector<const MS::FrameObject*> smallObjects;
+    std::vector<const MS::FrameObject*> largeObjects;
+
+    for (const auto frameIt : frameSet.frames()) {
+        for (const MS::FrameObject& obj : frameIt.second.objects()) {
+            if (obj.size() == MS::FrameObject::ObjectSize::SMALL) {
+                smallObjects.push_back(&obj);
+            }
+            else {
+                largeObjects.push_back(&obj);
+            }
+        }
+    }
+
+    // Do not modify the pool if the frameset is invalid
+    checkTileIds(frameSet.smallTileset(), smallObjects);
+    checkTileIds(frameSet.largeTileset(), largeObjects);
+
+    FrameSetStatistics ret;
+    TileMap tileMap;
+
+    addTilesToPool(_smallInserter, _smallTileset, frameSet.smallTileset(), smallObjects,
+                   tileMap.smallTiles, ret.nSmallTiles, ret.nNewSmallTiles);
+    addTilesToPool(_largeInserter, _largeTileset, frameSet.largeTileset(), largeObjects,
+                   tileMap.largeTiles, ret.nLargeTiles, ret.nNewLargeTiles);
+
+    _tileMaps.push_back(std::move(tileMap));
+
+    _statistics.nFrameSets++;
+    _statistics.nSmallTilesBefore += ret.nSmallTiles;
+    _statistics.nLargeTilesBefore += ret.nLargeTiles;
+    _statistics.nSmallTiles = _smallTileset.size();
+    _statistics.nLargeTiles = _largeTileset.size();
+
+    return ret;
+}
@@ -0,0 +1,97 @@
+#ifndef _UNTECH_MODELS_UTSI2UTMS_SHAREDTILEPOOL_H
+#define _UNTECH_MODELS_UTSI2UTMS_SHAREDTILEPOOL_H
+
+#include "tilesetinserter.h"
+#include "models/metasprite/frameset.h"
+#include "models/snes/tileset.h"
+#include <vector>
+
+namespace UnTech {
+
+/**
+ * A tileset pool shared by multiple MetaSprite framesets.
+ *
+ * The tiles used by the frame objects of each added frameset are
+ * deduplicated against the pool (using the TilesetInserter, so flipped
+ * tiles also match).
+ *
+ * The framesets are not modified, instead the pool records a TileMap
+ * from each frameset's tiles to the pool tiles.
+ *
+ * Tiles that are not used by any frame object are not added to the pool.
+ */
+class SharedTilePool {
+public:
+    // The frameset's tile is the pool tile flipped by hFlip/vFlip.
+    struct PoolTile {
+        bool used = false;
+        unsigned tileId = 0;
+        bool hFlip = false;
+        bool vFlip = false;
+    };
+
+    // Indexed by the frameset's tile ids.
+    struct TileMap {
+        std::vector<PoolTile> smallTiles;
+        std::vector<PoolTile> largeTiles;
+    };
+
+    struct Statistics {
+        unsigned nFrameSets = 0;
+
+        // the number of tiles used by the framesets' frame objects,
+        // unused tiles would be dropped without the pool
+        unsigned nSmallTilesBefore = 0;
+        unsigned nLargeTilesBefore = 0;
+
+        // the size of the pool
+        unsigned nSmallTiles = 0;
+        unsigned nLargeTiles = 0;
+
+        unsigned romBytesBefore() const;
+        unsigned romBytesAfter() const;
+        unsigned romBytesSaved() const { return romBytesBefore() - romBytesAfter(); }
+    };
+
+    // The number of tiles each frameset uses and how many of them were
+    // not already in the pool.
+    struct FrameSetStatistics {
+        unsigned nSmallTiles = 0;
+        unsigned nLargeTiles = 0;
+        unsigned nNewSmallTiles = 0;
+        unsigned nNewLargeTiles = 0;
+    };
+
+public:
+    SharedTilePool();
+    SharedTilePool(const SharedTilePool&) = delete;
+
+    /**
+     * Adds the tiles used by the frameset's frame objects to the pool.
+     *
+     * Raises an exception if a frame object's tileId is out of range.
+     */
+    FrameSetStatistics addFrameSet(const MetaSprite::FrameSet& frameSet);
+
+    /** The tile maps of the added framesets, in the order they were added */
+    const std::vector<TileMap>& tileMaps() const { return _tileMaps; }
+
+    const Snes::Tileset4bpp8px& smallTileset() const { return _smallTileset; }
+    const Snes::Tileset4bpp16px& largeTileset() const { return _largeTileset; }
+
+    const Statistics& statistics() const { return _statistics; }
+
+private:
+    Snes::Tileset4bpp8px _smallTileset;
+    Snes::Tileset4bpp16px _largeTileset;
+
+    Utsi2UtmsPrivate::TilesetInserter<Snes::Tileset4bpp8px> _smallInserter;
+    Utsi2UtmsPrivate::TilesetInserter<Snes::Tileset4bpp16px> _largeInserter;
+
+    std::vector<TileMap> _tileMaps;
+
+    Statistics _statistics;
+};
+}
+
+#endif
@@ -2,32 +2,89 @@
 #define _UNTECH_MODELS_UTSI2UTMS_TILESETINSERTER_H_
 
 #include "../snes/tileset.h"
+#include "overlappedtileindex.h"
+#include "utsi2utms.h"
 #include "../metasprite/frameobject.h"
+#include <algorithm>
+#include <cstring>
 #include <unordered_map>
 
 namespace UnTech {
 namespace Utsi2UtmsPrivate {
 
+/*
+ * A 64 bit hash of the entire tile.
+ *
+ * Based on xxHash64, the tile is processed as four independent lanes of
+ * 8 byte words so the multiplies can be pipelined, then the lanes are
+ * merged and avalanched.
+ */
 template <size_t ASIZE>
-struct TileHash {
-    size_t operator()(std::array<uint8_t, ASIZE> const& tile) const
-    {
-        constexpr unsigned BLOCK_SIZE = 4;
-        constexpr unsigned LOOP_COUNT = (ASIZE - sizeof(size_t)) / BLOCK_SIZE;
+inline uint64_t tileFingerprint(const std::array<uint8_t, ASIZE>& tile)
+{
+    static_assert(ASIZE % 32 == 0, "Tile size must be a multiple of 32 bytes");
+
+    constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+
+    auto rotl = [](uint64_t v, unsigned r) {
+        return (v << r) | (v >> (64 - r));
+    };
+
+    uint64_t acc[4] = { PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1 };
 
-        static_assert(sizeof(size_t) >= BLOCK_SIZE, "Bad assumption");
-        static_assert(sizeof(size_t) % BLOCK_SIZE == 0, "Bad assumption");
+    const uint8_t* ptr = tile.data();
 
-        size_t seed = 0;
-        const uint8_t* ptr = tile.data();
+    for (size_t i = 0; i < ASIZE; i += 32) {
+        for (unsigned l = 0; l < 4; l++) {
+            uint64_t word;
+            memcpy(&word, ptr + i + l * 8, sizeof(word));
 
-        for (unsigned i = 0; i < LOOP_COUNT; i++) {
-            // Numbers from boost
-            seed ^= (*(const size_t*)ptr) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-            ptr += BLOCK_SIZE;
+            acc[l] = rotl(acc[l] + word * PRIME2, 31) * PRIME1;
         }
+    }
+
+    uint64_t h = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+
+    return h;
+}
 
-        return seed;
+/*
+ * The TilesetInserter map key.
+ *
+ * The fingerprint is calculated once and is compared before the tile data.
+ */
+template <size_t ASIZE>
+struct TileKey {
+    uint64_t fingerprint;
+    std::array<uint8_t, ASIZE> tile;
+
+    TileKey(const std::array<uint8_t, ASIZE>& tile)
+        : fingerprint(tileFingerprint(tile))
+        , tile(tile)
+    {
+    }
+
+    bool operator==(const TileKey& o) const
+    {
+        return fingerprint == o.fingerprint && tile == o.tile;
+    }
+};
+
+template <size_t ASIZE>
+struct TileHash {
+    // noexcept: the fingerprint is already stored in the key,
+    // there is no need for the map to cache it.
+    size_t operator()(const TileKey<ASIZE>& key) const noexcept
+    {
+        return key.fingerprint;
     }
 };
 
@@ -51,141 +108,204 @@ struct TilesetInserterOutput {
     }
 };
 
+/*
+ * Deduplicates the tiles of a tileset, matching flipped tiles.
+ *
+ * Each tile is indexed once, by its canonical form: the lexicographically
+ * smallest of its four orientations. The map stores the flips that
+ * transform the tileset tile into the canonical form.
+ */
 template <class T>
 class TilesetInserter {
+    typedef typename T::tileData_t tileData_t;
+
+    constexpr static unsigned TILE_SIZE = T::TILE_SIZE;
+
 public:
     TilesetInserter(T& tileset)
         : _tileset(tileset)
         , _map()
+        , _overlapIndex()
     {
         for (unsigned t = 0; t < tileset.size(); t++) {
-            addToMap(tileset.tile(t), t);
+            tileData_t canonical;
+            const auto flips = canonicalForm(tileset.tile(t), canonical);
+
+            _map.insert({ canonical, { t, flips.hFlip, flips.vFlip } });
+            _overlapIndex.addTile(tileset.tile(t));
         }
     }
 
-    const TilesetInserterOutput getOrInsert(const typename T::tileData_t& tile)
+    const TilesetInserterOutput getOrInsert(const tileData_t& tile)
     {
-        auto it = _map.find(tile);
+        tileData_t canonical;
+        const auto flips = canonicalForm(tile, canonical);
+
+        auto it = _map.find(canonical);
 
         if (it != _map.end()) {
-            return it->second;
+            // canonical = itFlip(tileset tile) = flip(tile)
+            // As flips are self-inverse and commute:
+            //      tile = (flip * itFlip)(tileset tile)
+            const TilesetInserterOutput& to = it->second;
+
+            return { to.tileId, to.hFlip != flips.hFlip, to.vFlip != flips.vFlip };
         }
         else {
-            return insertNewTile(tile);
+            return insertNewTile(tile, canonical, flips);
         }
     }
 
-    const typename T::tileData_t getTile(const TilesetInserterOutput& tio) const
+    // Reads the tile from the tileset by id, returns an empty tile if
+    // the id is invalid.
+    const tileData_t getTile(const TilesetInserterOutput& tio) const
     {
-        static typename T::tileData_t zeroData = {};
-
-        // ::TODO optimize::
-        // ::: - get tile from the tileset and preform a flip::
+        static const tileData_t zeroData = {};
 
-        for (auto it : _map) {
-            if (it.second == tio) {
-                return it.first;
-            }
+        if (tio.tileId >= _tileset.size()) {
+            return zeroData;
         }
-        return zeroData;
+
+        return flipTile(_tileset.tile(tio.tileId), tio.hFlip, tio.vFlip);
     }
 
     const std::pair<TilesetInserterOutput, bool>
-    processOverlappedTile(const typename T::tileData_t& underTile,
+    processOverlappedTile(const tileData_t& underTile,
                           const typename std::array<bool, T::TILE_DATA_SIZE>& overlaps)
     {
-        unsigned bestScore = 0;
-        TilesetInserterOutput ret = { 0, false, false };
+        const auto match = _overlapIndex.findBestMatch(underTile, overlaps);
 
-        for (auto it : _map) {
-            const typename T::tileData_t& other = it.first;
-            unsigned score = 0;
-            bool found = true;
+        if (match.score != 0) {
+            return { { match.tileId, match.hFlip, match.vFlip }, true };
+        }
+        else {
+            tileData_t canonical;
+            const auto flips = canonicalForm(underTile, canonical);
 
-            for (unsigned i = 0; i < T::TILE_DATA_SIZE; i++) {
-                if (underTile[i] == other[i]) {
-                    score++;
-                }
-                else if (overlaps[i] == false) {
-                    found = false;
-                    break;
-                }
+            return { insertNewTile(underTile, canonical, flips), false };
+        }
+    }
+
+    TileHashStatistics statistics() const
+    {
+        TileHashStatistics stats;
+
+        stats.nTiles = _map.size();
+        stats.nBuckets = _map.bucket_count();
+        stats.nUsedBuckets = 0;
+        stats.maxBucketSize = 0;
+        stats.nBucketCollisions = 0;
+        stats.nFingerprintCollisions = 0;
+
+        for (size_t b = 0; b < _map.bucket_count(); b++) {
+            const size_t size = _map.bucket_size(b);
+
+            if (size > 0) {
+                stats.nUsedBuckets++;
+                stats.nBucketCollisions += size - 1;
+                stats.maxBucketSize = std::max(stats.maxBucketSize, size);
             }
 
-            if (found && score > bestScore) {
-                bestScore = score;
-                ret = it.second;
+            // Tiles with the same fingerprint are always in the same bucket
+            for (auto it = _map.begin(b); it != _map.end(b); ++it) {
+                for (auto jt = _map.begin(b); jt != it; ++jt) {
+                    if (it->first.fingerprint == jt->first.fingerprint) {
+                        stats.nFingerprintCollisions++;
+                        break;
+                    }
+                }
             }
         }
 
-        if (bestScore != 0) {
-            return { ret, true };
-        }
-        else {
-            return { insertNewTile(underTile), false };
-        }
+        return stats;
     }
 
 private:
-    TilesetInserterOutput insertNewTile(const typename T::tileData_t& tile)
+    struct Flips {
+        bool hFlip;
+        bool vFlip;
+    };
+
+    // The flip kernels are specialized for each tile size and orientation,
+    // the rows are copied (or reverse copied) with no per pixel index math.
+    template <bool HFLIP, bool VFLIP>
+    static void flipTileKernel(const tileData_t& tile, tileData_t& out)
     {
-        unsigned tileId = _tileset.size();
-        _tileset.addTile();
-        _tileset.tile(tileId) = tile;
-
-        addToMap(tile, tileId);
+        for (unsigned y = 0; y < TILE_SIZE; y++) {
+            const uint8_t* src = tile.data() + (VFLIP ? TILE_SIZE - 1 - y : y) * TILE_SIZE;
+            uint8_t* dest = out.data() + y * TILE_SIZE;
 
-        return { tileId, false, false };
+            if (HFLIP) {
+                std::reverse_copy(src, src + TILE_SIZE, dest);
+            }
+            else {
+                std::copy(src, src + TILE_SIZE, dest);
+            }
+        }
     }
 
-    void addToMap(const typename T::tileData_t& tile, unsigned tileId)
+    static tileData_t flipTile(const tileData_t& tile, bool hFlip, bool vFlip)
     {
-        // ::TODO check how symmetrical tiles are handled::
+        tileData_t ret;
 
-        constexpr unsigned TILE_SIZE = T::TILE_SIZE;
+        if (!hFlip && !vFlip) {
+            ret = tile;
+        }
+        else if (hFlip && !vFlip) {
+            flipTileKernel<true, false>(tile, ret);
+        }
+        else if (!hFlip && vFlip) {
+            flipTileKernel<false, true>(tile, ret);
+        }
+        else {
+            flipTileKernel<true, true>(tile, ret);
+        }
 
-        const uint8_t(*pixelData)[TILE_SIZE] = (uint8_t(*)[TILE_SIZE])tile.data();
+        return ret;
+    }
 
-        _map.insert({ tile, { tileId, false, false } });
+    // Returns the flips that transform tile into its canonical form.
+    // If the tile is symmetrical the first matching orientation is used.
+    static Flips canonicalForm(const tileData_t& tile, tileData_t& canonical)
+    {
+        Flips ret = { false, false };
+        canonical = tile;
 
-        // hflip
-        typename T::tileData_t hFlip;
-        uint8_t(*hData)[TILE_SIZE] = (uint8_t(*)[TILE_SIZE])hFlip.data();
+        for (unsigned f = 1; f < 4; f++) {
+            const bool hFlip = f & 1;
+            const bool vFlip = f & 2;
 
-        for (unsigned y = 0; y < TILE_SIZE; y++) {
-            for (unsigned x = 0; x < TILE_SIZE; x++) {
-                hData[y][x] = pixelData[y][TILE_SIZE - x - 1];
+            const tileData_t flipped = flipTile(tile, hFlip, vFlip);
+
+            if (flipped < canonical) {
+                canonical = flipped;
+                ret = { hFlip, vFlip };
             }
         }
-        _map.insert({ hFlip, { tileId, false, true } });
 
-        // vflip
-        typename T::tileData_t vFlip;
-        uint8_t(*vData)[TILE_SIZE] = (uint8_t(*)[TILE_SIZE])hFlip.data();
+        return ret;
+    }
 
-        for (unsigned y = 0; y < TILE_SIZE; y++) {
-            for (unsigned x = 0; x < TILE_SIZE; x++) {
-                vData[y][x] = pixelData[TILE_SIZE - y - 1][x];
-            }
-        }
-        _map.insert({ vFlip, { tileId, false, true } });
+    TilesetInserterOutput insertNewTile(const tileData_t& tile,
+                                        const tileData_t& canonical, const Flips flips)
+    {
+        unsigned tileId = _tileset.size();
+        _tileset.addTile();
+        _tileset.tile(tileId) = tile;
 
-        // hvflip
-        typename T::tileData_t hvFlip;
-        uint8_t(*hvData)[TILE_SIZE] = (uint8_t(*)[TILE_SIZE])hFlip.data();
-        for (unsigned y = 0; y < TILE_SIZE; y++) {
-            for (unsigned x = 0; x < TILE_SIZE; x++) {
-                hvData[y][x] = pixelData[TILE_SIZE - y - 1][TILE_SIZE - x - 1];
-            }
-        }
-        _map.insert({ hvFlip, { tileId, true, true } });
+        _map.insert({ canonical, { tileId, flips.hFlip, flips.vFlip } });
+        _overlapIndex.addTile(tile);
+
+        return { tileId, false, false };
     }
 
 private:
     T& _tileset;
 
-    std::unordered_map<typename T::tileData_t, TilesetInserterOutput,
+    std::unordered_map<TileKey<T::TILE_DATA_SIZE>, TilesetInserterOutput,
                        TileHash<T::TILE_DATA_SIZE>> _map;
+
+    OverlappedTileIndex<TILE_SIZE, T::PIXEL_MASK + 1> _overlapIndex;
 };
 }
 }
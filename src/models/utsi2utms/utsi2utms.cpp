@@ -1,15 +1,19 @@
 #include "utsi2utms.h"
+#include "paletteindex.h"
 #include "tilesetinserter.h"
+#include "models/common/parallelfor.h"
 #include "models/metasprite.h"
+#include "models/metasprite/tilesetorder.h"
 #include "models/sprite-importer.h"
 #include <algorithm>
 #include <cassert>
-#include <iterator>
 #include <map>
-#include <set>
 #include <sstream>
+#include <stdexcept>
 #include <string>
-#include <unordered_set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <iostream>
 
@@ -22,7 +26,7 @@ namespace MS = UnTech::MetaSprite;
 namespace SI = UnTech::SpriteImporter;
 
 inline std::array<uint8_t, 8 * 8> getSmallTile(const Image& image,
-                                               const std::map<rgba, unsigned>& colorMap,
+                                               const PaletteIndex& colorMap,
                                                const SI::FrameObject& siObj)
 {
     unsigned xOffset = siObj.frame().location().x + siObj.location().x;
@@ -42,7 +46,7 @@ inline std::array<uint8_t, 8 * 8> getSmallTile(const Image& image,
 }
 
 inline std::array<uint8_t, 16 * 16> getLargeTile(const Image& image,
-                                                 const std::map<rgba, unsigned>& colorMap,
+                                                 const PaletteIndex& colorMap,
                                                  const SI::FrameObject& siObj)
 {
     unsigned xOffset = siObj.frame().location().x + siObj.location().x;
@@ -61,54 +65,306 @@ inline std::array<uint8_t, 16 * 16> getLargeTile(const Image& image,
     return tile;
 }
 
-// mark the pixels in the undertile that are overlapped by the overtile
-template <unsigned OVER_SIZE, unsigned UNDER_SIZE>
-inline std::array<bool, UNDER_SIZE * UNDER_SIZE>
-markOverlappedPixels(const std::array<uint8_t, OVER_SIZE * OVER_SIZE>& overTile,
-                     int xOffset, int yOffset)
+// The tile data of a single SI::FrameObject
+struct ObjectTile {
+    std::array<uint8_t, 8 * 8> small;
+    std::array<uint8_t, 16 * 16> large;
+
+    // empty if the tile was extracted successfully
+    std::string error;
+};
+
+template <unsigned SIZE>
+inline const std::array<uint8_t, SIZE * SIZE>& objectTileData(const ObjectTile& tile);
+
+template <>
+inline const std::array<uint8_t, 8 * 8>& objectTileData<8>(const ObjectTile& tile)
 {
-    std::array<bool, UNDER_SIZE* UNDER_SIZE> ret = {};
+    return tile.small;
+}
 
-    for (unsigned oY = 0; oY < OVER_SIZE; oY++) {
-        int uY = oY + yOffset;
+template <>
+inline const std::array<uint8_t, 16 * 16>& objectTileData<16>(const ObjectTile& tile)
+{
+    return tile.large;
+}
 
-        if (uY >= 0 && uY < (int)UNDER_SIZE) {
-            for (unsigned oX = 0; oX < OVER_SIZE; oX++) {
-                int uX = oX + xOffset;
+inline const uint8_t* objectTileData(const ObjectTile& tile, const SI::FrameObject& siObj)
+{
+    if (siObj.size() == SI::FrameObject::ObjectSize::SMALL) {
+        return tile.small.data();
+    }
+    else {
+        return tile.large.data();
+    }
+}
 
-                if (uX >= 0 && uX < (int)UNDER_SIZE) {
-                    if (overTile[oY * OVER_SIZE + oX] != 0) {
-                        ret[uY * UNDER_SIZE + uX] = true;
-                    }
+/*
+ * The overlap graph of a single frame.
+ *
+ * Frame objects are drawn in reverse order, the first object is on top.
+ */
+struct OverlapGraph {
+    // object id -> the overlapping objects drawn in front of it
+    std::vector<std::vector<unsigned>> front;
+
+    // object id -> the overlapping objects drawn behind it
+    std::vector<std::vector<unsigned>> behind;
+
+    OverlapGraph(const SI::Frame& siFrame)
+        : front(siFrame.objects().size())
+        , behind(siFrame.objects().size())
+    {
+        const auto& fobjs = siFrame.objects();
+
+        for (unsigned i = 0; i < fobjs.size(); i++) {
+            const SI::FrameObject& iObj = fobjs.at(i);
+            const urect iRect(iObj.location(), iObj.sizePx());
+
+            for (unsigned j = i + 1; j < fobjs.size(); j++) {
+                const SI::FrameObject& jObj = fobjs.at(j);
+
+                if (iRect.overlaps(jObj.location(), jObj.sizePx())) {
+                    behind[i].push_back(j);
+                    front[j].push_back(i);
                 }
             }
         }
     }
 
-    return ret;
+    bool overlapping(unsigned id) const
+    {
+        return !front.at(id).empty() || !behind.at(id).empty();
+    }
+
+    bool empty() const
+    {
+        for (unsigned id = 0; id < front.size(); id++) {
+            if (overlapping(id)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+     * Returns the overlapping objects in the order they are processed.
+     *
+     * Every object comes after all of the objects behind it. Otherwise
+     * the objects are in frame order.
+     */
+    std::vector<unsigned> processingOrder() const
+    {
+        std::vector<unsigned> order;
+        std::vector<bool> visited(front.size(), false);
+
+        for (unsigned id = 0; id < front.size(); id++) {
+            if (overlapping(id)) {
+                appendProcessingOrder(id, visited, order);
+            }
+        }
+
+        return order;
+    }
+
+private:
+    void appendProcessingOrder(unsigned id, std::vector<bool>& visited,
+                               std::vector<unsigned>& order) const
+    {
+        if (visited[id]) {
+            return;
+        }
+        visited[id] = true;
+
+        for (unsigned b : behind[id]) {
+            appendProcessingOrder(b, visited, order);
+        }
+        order.push_back(id);
+    }
+};
+
+// Calls `func(i, o)` for every pixel of `other` that is inside `siObj`.
+// `i` is the pixel index in `siObj` and `o` is the pixel index in `other`.
+template <unsigned SIZE, class Func>
+inline void forEachOverlappingPixel(const SI::FrameObject& siObj, const SI::FrameObject& other,
+                                    const Func& func)
+{
+    const unsigned otherSize = other.sizePx();
+
+    const int xOffset = int(other.location().x) - int(siObj.location().x);
+    const int yOffset = int(other.location().y) - int(siObj.location().y);
+
+    for (unsigned oY = 0; oY < otherSize; oY++) {
+        int y = oY + yOffset;
+
+        if (y >= 0 && y < (int)SIZE) {
+            for (unsigned oX = 0; oX < otherSize; oX++) {
+                int x = oX + xOffset;
+
+                if (x >= 0 && x < (int)SIZE) {
+                    func(y * SIZE + x, oY * otherSize + oX);
+                }
+            }
+        }
+    }
 }
 
-// clears the pixels in the overtile that match the undertile.
-template <unsigned OVER_SIZE, unsigned UNDER_SIZE>
-inline void clearCommonOverlappedTiles(std::array<uint8_t, OVER_SIZE * OVER_SIZE>& overTile,
-                                       const std::array<uint8_t, UNDER_SIZE * UNDER_SIZE>& underTile,
-                                       int xOffset, int yOffset)
+// The processed pixels of an overlapping frame object.
+struct Layer {
+    // the tile drawn by the MS frame object, SIZE * SIZE pixels
+    std::array<uint8_t, 16 * 16> pixels;
+
+    bool empty = false;
+};
+
+enum class LayerResult {
+    MATCHED,
+    NOT_FOUND,
+    EMPTY
+};
+
+/*
+ * Processes a single overlapping frame object.
+ *
+ * The objects behind it must already be processed.
+ *
+ * This:
+ *   - Clears the pixels that are the same as the (already processed)
+ *     objects behind it.
+ *   - Marks the pixels that can be covered by the objects in front of it.
+ *   - Searches for a tile that matches the uncovered pixels, creating a new
+ *     tile if necessary.
+ */
+template <class TilesetT>
+LayerResult processLayer(TilesetInserter<TilesetT>& tileset,
+                         const SI::Frame& siFrame, const std::vector<ObjectTile>& tiles,
+                         const OverlapGraph& graph, std::vector<Layer>& layers,
+                         unsigned id, MS::FrameObject& msObj)
 {
-    for (unsigned oY = 0; oY < OVER_SIZE; oY++) {
-        int uY = oY + yOffset;
+    constexpr unsigned SIZE = TilesetT::TILE_SIZE;
+    typedef typename TilesetT::tileData_t tileData_t;
+
+    auto objectTile = [&](unsigned i) -> const ObjectTile& {
+        const ObjectTile& t = tiles.at(i);
+        if (!t.error.empty()) {
+            throw std::out_of_range(t.error);
+        }
+        return t;
+    };
 
-        if (uY >= 0 && uY < (int)UNDER_SIZE) {
-            for (unsigned oX = 0; oX < OVER_SIZE; oX++) {
-                int uX = oX + xOffset;
+    const auto& fobjs = siFrame.objects();
+    const SI::FrameObject& siObj = fobjs.at(id);
+    Layer& layer = layers.at(id);
 
-                if (uX >= 0 && uX < (int)UNDER_SIZE) {
-                    if (overTile[oY * OVER_SIZE + oX] == underTile[uY * UNDER_SIZE + uX]) {
-                        overTile[oY * OVER_SIZE + oX] = 0;
+    tileData_t tile = objectTileData<SIZE>(objectTile(id));
+
+    // Paint the objects behind back to front, the visible pixel wins.
+    {
+        tileData_t behind = {};
+
+        const auto& behindIds = graph.behind.at(id);
+        for (auto it = behindIds.rbegin(); it != behindIds.rend(); ++it) {
+            const Layer& b = layers.at(*it);
+
+            if (!b.empty) {
+                forEachOverlappingPixel<SIZE>(siObj, fobjs.at(*it), [&](unsigned i, unsigned o) {
+                    if (b.pixels[o] != 0) {
+                        behind[i] = b.pixels[o];
                     }
-                }
+                });
             }
         }
+
+        for (unsigned i = 0; i < tile.size(); i++) {
+            if (tile[i] == behind[i]) {
+                tile[i] = 0;
+            }
+        }
+    }
+
+    static const tileData_t zeroTile = {};
+    if (tile == zeroTile) {
+        layer.empty = true;
+        return LayerResult::EMPTY;
+    }
+
+    const auto& frontIds = graph.front.at(id);
+
+    if (frontIds.empty()) {
+        auto to = tileset.getOrInsert(tile);
+        to.apply(msObj);
+
+        std::copy(tile.begin(), tile.end(), layer.pixels.begin());
+
+        return LayerResult::MATCHED;
     }
+
+    std::array<bool, SIZE * SIZE> overlaps = {};
+    for (unsigned f : frontIds) {
+        const uint8_t* frontTile = objectTileData(objectTile(f), fobjs.at(f));
+
+        forEachOverlappingPixel<SIZE>(siObj, fobjs.at(f), [&](unsigned i, unsigned o) {
+            if (frontTile[o] != 0) {
+                overlaps[i] = true;
+            }
+        });
+    }
+
+    auto ret = tileset.processOverlappedTile(tile, overlaps);
+    ret.first.apply(msObj);
+
+    const tileData_t drawn = tileset.getTile(ret.first);
+    std::copy(drawn.begin(), drawn.end(), layer.pixels.begin());
+
+    return ret.second ? LayerResult::MATCHED : LayerResult::NOT_FOUND;
+}
+
+/*
+ * Extracts and color maps the tiles of every frame object in the frameset.
+ *
+ * The work is spread across multiple threads. The returned tiles are
+ * processed by the (serial) TilesetInserter in frameset order so the tile
+ * ids are the same regardless of thread count.
+ */
+inline std::unordered_map<const SI::Frame*, std::vector<ObjectTile>>
+extractFrameObjectTiles(const Image& image,
+                        const PaletteIndex& colorMap,
+                        const SI::FrameSet& siFrameSet,
+                        unsigned nThreads)
+{
+    std::unordered_map<const SI::Frame*, std::vector<ObjectTile>> ret;
+
+    std::vector<std::pair<const SI::FrameObject*, ObjectTile*>> work;
+
+    for (const auto frameIt : siFrameSet.frames()) {
+        const SI::Frame& siFrame = frameIt.second;
+
+        auto& tiles = ret[&siFrame];
+        tiles.resize(siFrame.objects().size());
+
+        for (size_t i = 0; i < tiles.size(); i++) {
+            work.emplace_back(&siFrame.objects().at(i), &tiles[i]);
+        }
+    }
+
+    parallelFor(work.size(), nThreads, [&](size_t i) {
+        const SI::FrameObject& siObj = *work[i].first;
+        ObjectTile& tile = *work[i].second;
+
+        try {
+            if (siObj.size() == SI::FrameObject::ObjectSize::SMALL) {
+                tile.small = getSmallTile(image, colorMap, siObj);
+            }
+            else {
+                tile.large = getLargeTile(image, colorMap, siObj);
+            }
+        }
+        catch (const std::exception& ex) {
+            tile.error = ex.what();
+        }
+    });
+
+    return ret;
 }
 }
 }
@@ -119,13 +375,21 @@ using namespace UnTech::Utsi2UtmsPrivate;
 Utsi2Utms::Utsi2Utms()
     : _errors()
     , _warnings()
+    , _nThreads(0)
     , _hasError(false)
 {
 }
 
+void Utsi2Utms::setThreadCount(unsigned nThreads)
+{
+    _nThreads = nThreads;
+}
+
 std::unique_ptr<MS::MetaSpriteDocument> Utsi2Utms::convert(SI::SpriteImporterDocument& siDocument)
 {
     _hasError = false;
+    _smallTileHashStatistics = TileHashStatistics();
+    _largeTileHashStatistics = TileHashStatistics();
 
     const SI::FrameSet& siFrameSet = siDocument.frameSet();
     const UnTech::Image& image = siDocument.frameSet().image();
@@ -153,10 +417,11 @@ std::unique_ptr<MS::MetaSpriteDocument> Utsi2Utms::convert(SI::SpriteImporterDoc
     msFrameSet.setName(siFrameSet.name());
 
     // Build map of rgba to palette color
-    // Faster than std::unordered_map, only contains 16 elements
-    std::map<rgba, unsigned> colorMap;
+    PaletteIndex colorMap;
     {
-        std::set<rgba> colors;
+        static_assert(PaletteIndex::MAX_COLORS == PALETTE_COLORS, "Bad assumption");
+
+        PaletteIndex colors;
 
         for (const auto siFrameIt : siFrameSet.frames()) {
             const SI::Frame& siFrame = siFrameIt.second;
@@ -172,29 +437,47 @@ std::unique_ptr<MS::MetaSpriteDocument> Utsi2Utms::convert(SI::SpriteImporterDoc
 
                 for (unsigned y = 0; y < obj.sizePx(); y++) {
                     const rgba* p = image.scanline(ly + y) + lx;
+                    rgba previous = *p;
 
-                    for (unsigned x = 0; x < obj.sizePx(); x++) {
-                        colors.insert(*p++);
+                    if (!colors.insert(previous)) {
+                        addError(siFrameSet, "Too many colors, expected a max of 16");
+                        return nullptr;
                     }
-                }
 
-                if (colors.size() > PALETTE_COLORS) {
-                    addError(siFrameSet, "Too many colors, expected a max of 16");
-                    return nullptr;
+                    for (unsigned x = 1; x < obj.sizePx(); x++) {
+                        p++;
+
+                        // Most neighbouring pixels are the same color
+                        if (*p != previous) {
+                            previous = *p;
+
+                            if (!colors.insert(previous)) {
+                                addError(siFrameSet, "Too many colors, expected a max of 16");
+                                return nullptr;
+                            }
+                        }
+                    }
                 }
             }
         }
 
-        auto tIt = colors.find(siFrameSet.transparentColor());
-        if (tIt != colors.end()) {
-            colors.erase(tIt);
+        // The palette is ordered by rgba value (excluding transparency).
+        std::vector<rgba> sortedColors;
+        sortedColors.reserve(colors.size());
+
+        for (unsigned i = 0; i < colors.size(); i++) {
+            if (colors.color(i) != siFrameSet.transparentColor()) {
+                sortedColors.push_back(colors.color(i));
+            }
         }
-        else {
+        std::sort(sortedColors.begin(), sortedColors.end());
+
+        if (sortedColors.size() == colors.size()) {
             addWarning(siFrameSet, "Transparent color is not in frame objects");
         }
 
         // Verify enough colors after remove transparency
-        if (colors.size() > (PALETTE_COLORS - 1)) {
+        if (sortedColors.size() > (PALETTE_COLORS - 1)) {
             addError(siFrameSet, "Too many colors, expected a max of 16");
             return nullptr;
         }
@@ -204,12 +487,12 @@ std::unique_ptr<MS::MetaSpriteDocument> Utsi2Utms::convert(SI::SpriteImporterDoc
         {
             MS::Palette& palette = msFrameSet.palettes().create();
 
-            colorMap.insert({ siFrameSet.transparentColor(), 0 });
+            colorMap.insert(siFrameSet.transparentColor());
             palette.color(0).setRgb(siFrameSet.transparentColor());
 
             int i = 1;
-            for (auto& c : colors) {
-                colorMap.insert({ c, i });
+            for (auto& c : sortedColors) {
+                colorMap.insert(c);
                 palette.color(i).setRgb(c);
                 i++;
             }
@@ -220,22 +503,31 @@ std::unique_ptr<MS::MetaSpriteDocument> Utsi2Utms::convert(SI::SpriteImporterDoc
         return nullptr;
     }
 
+    unsigned nThreads = _nThreads;
+    if (nThreads == 0) {
+        nThreads = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    const auto frameObjectTiles = extractFrameObjectTiles(image, colorMap, siFrameSet, nThreads);
+
     TilesetInserter<Snes::Tileset4bpp8px> smallTileset(msFrameSet.smallTileset());
     TilesetInserter<Snes::Tileset4bpp16px> largeTileset(msFrameSet.largeTileset());
 
-    auto getTilesetOutputFromImage = [&](const SI::FrameObject& siObj) {
+    auto getTilesetOutputFromTile = [&](const SI::FrameObject& siObj, const ObjectTile& tile) {
+        if (!tile.error.empty()) {
+            throw std::out_of_range(tile.error);
+        }
+
         if (siObj.size() == SI::FrameObject::ObjectSize::SMALL) {
-            return smallTileset.getOrInsert(getSmallTile(image, colorMap, siObj));
+            return smallTileset.getOrInsert(tile.small);
         }
         else {
-            return largeTileset.getOrInsert(getLargeTile(image, colorMap, siObj));
+            return largeTileset.getOrInsert(tile.large);
         }
     };
 
-    // A Mapping to store all the frame objects that overlap each other.
-    // Mapping of <frameName> -> <objectIDs> -> list<overlapping objectIDs>
-    std::map<const std::string,
-             std::map<unsigned, std::list<unsigned>>> overlappingFrameObjectsMap;
+    // The overlap graphs of the frames that contain overlapping objects.
+    std::map<const std::string, OverlapGraph> frameOverlaps;
 
     // Process frames
     for (const auto frameIt : siFrameSet.frames()) {
@@ -245,46 +537,24 @@ std::unique_ptr<MS::MetaSpriteDocument> Utsi2Utms::convert(SI::SpriteImporterDoc
         MS::Frame* msFramePtr = msFrameSet.frames().create(frameIt.first);
         MS::Frame& msFrame = *msFramePtr;
 
-        std::unordered_set<const SI::FrameObject*> overlapping;
-
-        // Search for overlapping frame objects
-        {
-            typedef SI::FrameObject::list_t::const_iterator f_iterator;
+        const std::vector<ObjectTile>& tiles = frameObjectTiles.at(&siFrame);
 
-            const auto& fobjs = siFrame.objects();
-
-            for (f_iterator iIt = fobjs.begin(); iIt != fobjs.end(); ++iIt) {
-                const SI::FrameObject& iObj = *iIt;
-                const urect iRect(iObj.location(), iObj.sizePx());
-
-                for (f_iterator jIt = iIt + 1; jIt != fobjs.end(); ++jIt) {
-                    const SI::FrameObject& jObj = *jIt;
-
-                    if (iRect.overlaps(jObj.location(), jObj.sizePx())) {
-                        overlapping.insert(&iObj);
-                        overlapping.insert(&jObj);
-
-                        unsigned di = std::distance(fobjs.begin(), iIt);
-                        unsigned dj = std::distance(fobjs.begin(), jIt);
-                        overlappingFrameObjectsMap[frameIt.first][di].push_back(dj);
-                    }
-                }
-            }
-        }
+        OverlapGraph overlapGraph(siFrame);
 
         try {
-            for (const SI::FrameObject& siObj : siFrame.objects()) {
+            for (size_t i = 0; i < tiles.size(); i++) {
+                const SI::FrameObject& siObj = siFrame.objects().at(i);
                 MS::FrameObject& msObj = msFrame.objects().create();
 
                 msObj.setSize(static_cast<MS::FrameObject::ObjectSize>(siObj.size()));
                 msObj.setLocation(ms8point::createFromOffset(siObj.location(), siFrameOrigin));
 
-                if (overlapping.count(&siObj) > 0) {
+                if (overlapGraph.overlapping(i)) {
                     // don't process overlapping tiles here
                     continue;
                 }
 
-                auto to = getTilesetOutputFromImage(siObj);
+                auto to = getTilesetOutputFromTile(siObj, tiles[i]);
                 to.apply(msObj);
             }
 
@@ -316,148 +586,59 @@ std::unique_ptr<MS::MetaSpriteDocument> Utsi2Utms::convert(SI::SpriteImporterDoc
             addError(siFrame, ex.what());
             continue;
         }
+
+        if (!overlapGraph.empty()) {
+            frameOverlaps.emplace(frameIt.first, std::move(overlapGraph));
+        }
     }
 
     if (_hasError) {
         return nullptr;
     }
 
-    bool useSmall;
-    struct {
-        std::array<uint8_t, 8 * 8> small;
-        std::array<uint8_t, 16 * 16> large;
-    } overTile;
+    // Process the overlapping objects, any number of objects can overlap.
+    for (const auto& overlapsIt : frameOverlaps) {
+        const OverlapGraph& graph = overlapsIt.second;
 
-    for (const auto overlappingFramesIt : overlappingFrameObjectsMap) {
-        const auto& frameObjectOverlaps = overlappingFramesIt.second;
-
-        const SI::Frame& siFrame = siFrameSet.frames().at(overlappingFramesIt.first);
-        MS::Frame& msFrame = msFrameSet.frames().at(overlappingFramesIt.first);
-
-        // Check that there is no triple overlapping tile
-        {
-            std::set<unsigned> matches;
-            for (auto foIt : frameObjectOverlaps) {
-                for (unsigned id : foIt.second) {
-                    auto ret = matches.insert(id);
-
-                    if (ret.second == false) {
-                        addError(siFrame, "Cannot have three or more overlapping tiles");
-                        return nullptr;
-                    }
-                }
-            }
-        }
+        const SI::Frame& siFrame = siFrameSet.frames().at(overlapsIt.first);
+        MS::Frame& msFrame = msFrameSet.frames().at(overlapsIt.first);
 
-        std::set<MS::FrameObject*> emptyObjects;
+        const std::vector<ObjectTile>& tiles = frameObjectTiles.at(&siFrame);
 
-        // Process the overlapping tiles
-        for (auto foIt : frameObjectOverlaps) {
-            const SI::FrameObject& siOverObj = siFrame.objects().at(foIt.first);
-            MS::FrameObject& msOverObj = msFrame.objects().at(foIt.first);
+        std::vector<Layer> layers(siFrame.objects().size());
+        std::vector<MS::FrameObject*> emptyObjects;
 
-            if (siOverObj.size() == SI::FrameObject::ObjectSize::SMALL) {
-                overTile.small = getSmallTile(image, colorMap, siOverObj);
-                useSmall = true;
-            }
-            else {
-                overTile.large = getLargeTile(image, colorMap, siOverObj);
-                useSmall = false;
-            }
+        try {
+            for (unsigned id : graph.processingOrder()) {
+                const SI::FrameObject& siObj = siFrame.objects().at(id);
+                MS::FrameObject& msObj = msFrame.objects().at(id);
 
-            for (unsigned id : foIt.second) {
-                const SI::FrameObject& siUnderObj = siFrame.objects().at(id);
-                MS::FrameObject& msUnderObj = msFrame.objects().at(id);
-
-                int xOffset = siOverObj.location().x - siUnderObj.location().x;
-                int yOffset = siOverObj.location().y - siUnderObj.location().y;
-
-                /*
-                 * This:
-                 *   - Gets the undertile pixels
-                 *   - Mark the undertile pixels that are overlapped with 0xFF
-                 *   - Search for duplicate tiles, creating a new tile if necessary
-                 */
-                std::pair<TilesetInserterOutput, bool> tilesetOutput;
-                if (useSmall) {
-                    if (siUnderObj.size() == SI::FrameObject::ObjectSize::SMALL) {
-                        auto underTile = getSmallTile(image, colorMap, siUnderObj);
-                        auto overlaps = markOverlappedPixels<8, 8>(overTile.small, xOffset, yOffset);
-                        tilesetOutput = smallTileset.processOverlappedTile(underTile, overlaps);
-                    }
-                    else {
-                        auto underTile = getLargeTile(image, colorMap, siUnderObj);
-                        auto overlaps = markOverlappedPixels<8, 16>(overTile.small, xOffset, yOffset);
-                        tilesetOutput = largeTileset.processOverlappedTile(underTile, overlaps);
-                    }
+                LayerResult result;
+                if (siObj.size() == SI::FrameObject::ObjectSize::SMALL) {
+                    result = processLayer(smallTileset, siFrame, tiles, graph, layers, id, msObj);
                 }
                 else {
-                    if (siUnderObj.size() == SI::FrameObject::ObjectSize::SMALL) {
-                        auto underTile = getSmallTile(image, colorMap, siUnderObj);
-                        auto overlaps = markOverlappedPixels<16, 8>(overTile.large, xOffset, yOffset);
-                        tilesetOutput = smallTileset.processOverlappedTile(underTile, overlaps);
-                    }
-                    else {
-                        auto underTile = getLargeTile(image, colorMap, siUnderObj);
-                        auto overlaps = markOverlappedPixels<16, 16>(overTile.large, xOffset, yOffset);
-                        tilesetOutput = largeTileset.processOverlappedTile(underTile, overlaps);
-                    }
-                }
-                tilesetOutput.first.apply(msUnderObj);
-
-                if (tilesetOutput.second == false) {
-                    addWarning(siUnderObj, "Matching undertile not found");
+                    result = processLayer(largeTileset, siFrame, tiles, graph, layers, id, msObj);
                 }
 
-                // remove duplicate pixels in the overtile that match the processed undertile.
-                if (useSmall) {
-                    if (siUnderObj.size() == SI::FrameObject::ObjectSize::SMALL) {
-                        auto underTile = smallTileset.getTile(tilesetOutput.first);
-                        clearCommonOverlappedTiles<8, 8>(overTile.small, underTile, xOffset, yOffset);
-                    }
-                    else {
-                        auto underTile = largeTileset.getTile(tilesetOutput.first);
-                        clearCommonOverlappedTiles<8, 16>(overTile.small, underTile, xOffset, yOffset);
-                    }
+                if (result == LayerResult::NOT_FOUND) {
+                    addWarning(siObj, "Matching undertile not found");
                 }
-                else {
-                    if (siUnderObj.size() == SI::FrameObject::ObjectSize::SMALL) {
-                        auto underTile = smallTileset.getTile(tilesetOutput.first);
-                        clearCommonOverlappedTiles<16, 8>(overTile.large, underTile, xOffset, yOffset);
+                else if (result == LayerResult::EMPTY) {
+                    if (graph.front.at(id).empty()) {
+                        addWarning(siObj, "Overtile is empty - skipping");
                     }
                     else {
-                        auto underTile = largeTileset.getTile(tilesetOutput.first);
-                        clearCommonOverlappedTiles<16, 16>(overTile.large, underTile, xOffset, yOffset);
+                        addWarning(siObj, "Undertile is empty - skipping");
                     }
-                }
-            }
-
-            // create the overtile and add to the tileset
-            if (useSmall) {
-                static const std::array<uint8_t, 8 * 8> smallZero = {};
-
-                if (overTile.small != smallZero) {
-                    auto to = smallTileset.getOrInsert(overTile.small);
-                    to.apply(msOverObj);
-                }
-                else {
-                    addWarning(siOverObj, "Overtile is empty - skipping");
-                    emptyObjects.insert(&msOverObj);
-                }
-            }
-            else {
-                static const std::array<uint8_t, 16 * 16> largeZero = {};
-
-                if (overTile.large != largeZero) {
-                    auto to = largeTileset.getOrInsert(overTile.large);
-                    to.apply(msOverObj);
-                }
-                else {
-                    addWarning(siOverObj, "Overtile is empty - skipping");
-                    emptyObjects.insert(&msOverObj);
+                    emptyObjects.push_back(&msObj);
                 }
             }
         }
+        catch (const std::out_of_range& ex) {
+            addError(siFrame, ex.what());
+            continue;
+        }
 
         // remove empty frame objects
         for (MS::FrameObject* obj : emptyObjects) {
@@ -465,6 +646,17 @@ std::unique_ptr<MS::MetaSpriteDocument> Utsi2Utms::convert(SI::SpriteImporterDoc
         }
     }
 
+    if (_hasError) {
+        return nullptr;
+    }
+
+    _smallTileHashStatistics = smallTileset.statistics();
+    _largeTileHashStatistics = largeTileset.statistics();
+
+    // The tilesets are in insertion order, regroup them so each frame
+    // can be loaded with as few DMA transfers as possible.
+    MS::optimizeTilesetOrder(msFrameSet);
+
     return msDocument;
 }
 
@@ -10,15 +10,42 @@
 
 namespace UnTech {
 
+/**
+ * Bucket statistics of the tileset deduplication map.
+ */
+struct TileHashStatistics {
+    size_t nTiles = 0;
+    size_t nBuckets = 0;
+    size_t nUsedBuckets = 0;
+    size_t maxBucketSize = 0;
+
+    // number of tiles in a bucket beyond its first
+    size_t nBucketCollisions = 0;
+
+    // number of tiles with the same 64 bit fingerprint as an earlier tile
+    // in their bucket
+    size_t nFingerprintCollisions = 0;
+};
+
 class Utsi2Utms {
 public:
     Utsi2Utms();
 
     std::unique_ptr<MetaSprite::MetaSpriteDocument> convert(SpriteImporter::SpriteImporterDocument& si);
 
+    /**
+     * Sets the number of threads used to extract the frame tiles.
+     * If 0 (the default) then the number of hardware threads is used.
+     */
+    void setThreadCount(unsigned nThreads);
+
     const std::list<std::string>& errors() const { return _errors; }
     const std::list<std::string>& warnings() const { return _warnings; }
 
+    /** The tile hash statistics of the last conversion */
+    const TileHashStatistics& smallTileHashStatistics() const { return _smallTileHashStatistics; }
+    const TileHashStatistics& largeTileHashStatistics() const { return _largeTileHashStatistics; }
+
 protected:
     void addError(const std::string& message);
     void addError(const SpriteImporter::FrameSet& frameSet, const std::string& message);
@@ -32,6 +59,10 @@ private:
     std::list<std::string> _errors;
     std::list<std::string> _warnings;
 
+    TileHashStatistics _smallTileHashStatistics;
+    TileHashStatistics _largeTileHashStatistics;
+
+    unsigned _nThreads;
     bool _hasError;
 };
 }
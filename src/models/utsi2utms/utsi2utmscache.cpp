@@ -0,0 +1,305 @@
+#include "utsi2utmscache.h"
+#include "models/common/atomicofstream.h"
+#include "models/common/file.h"
+#include "models/sprite-importer/serializer.h"
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <sys/stat.h>
+
+using namespace UnTech;
+
+namespace SI = UnTech::SpriteImporter;
+
+namespace UnTech {
+namespace Utsi2UtmsPrivate {
+
+// 64 bit FNV-1a
+class Fnv1a {
+public:
+    void add(const void* data, size_t size)
+    {
+        const uint8_t* ptr = static_cast<const uint8_t*>(data);
+        const uint8_t* endPtr = ptr + size;
+
+        while (ptr < endPtr) {
+            _hash ^= *ptr++;
+            _hash *= 0x100000001b3ULL;
+        }
+    }
+
+    void add(const std::string& s) { add(s.data(), s.size()); }
+
+    std::string hex() const
+    {
+        std::stringstream out;
+        out << std::hex << std::setw(16) << std::setfill('0') << _hash;
+        return out.str();
+    }
+
+private:
+    uint64_t _hash = 0xcbf29ce484222325ULL;
+};
+
+struct FileStat {
+    long long size = -1;
+    long long mtime = 0;
+
+    static FileStat fromFile(const std::string& filename)
+    {
+        FileStat ret;
+        struct stat statbuf;
+
+        if (!filename.empty() && stat(filename.c_str(), &statbuf) == 0) {
+            ret.size = statbuf.st_size;
+            ret.mtime = statbuf.st_mtime;
+        }
+        return ret;
+    }
+
+    bool operator==(const FileStat& o) const
+    {
+        return size == o.size && mtime == o.mtime;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const FileStat& s)
+{
+    return out << s.size << ' ' << s.mtime;
+}
+
+inline std::istream& operator>>(std::istream& in, FileStat& s)
+{
+    return in >> s.size >> s.mtime;
+}
+
+// Warnings are stored one per line, escapes the newlines and backslashes
+inline std::string escapeLine(const std::string& line)
+{
+    std::string ret;
+    ret.reserve(line.size());
+
+    for (char c : line) {
+        switch (c) {
+        case '\\':
+            ret += "\\\\";
+            break;
+
+        case '\n':
+            ret += "\\n";
+            break;
+
+        case '\r':
+            ret += "\\r";
+            break;
+
+        default:
+            ret += c;
+        }
+    }
+    return ret;
+}
+
+inline bool unescapeLine(const std::string& line, std::string& out)
+{
+    out.clear();
+    out.reserve(line.size());
+
+    for (auto it = line.begin(); it != line.end(); ++it) {
+        if (*it != '\\') {
+            out += *it;
+            continue;
+        }
+
+        ++it;
+        if (it == line.end()) {
+            return false;
+        }
+
+        switch (*it) {
+        case '\\':
+            out += '\\';
+            break;
+
+        case 'n':
+            out += '\n';
+            break;
+
+        case 'r':
+            out += '\r';
+            break;
+
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool readBinaryFile(const std::string& filename, std::string& out)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    in.seekg(0, std::ios::end);
+    out.resize(in.tellg());
+    in.seekg(0, std::ios::beg);
+
+    in.read(&out[0], out.size());
+
+    return !in.fail();
+}
+}
+}
+
+using namespace UnTech::Utsi2UtmsPrivate;
+
+Utsi2UtmsCache::Utsi2UtmsCache(const std::string& cacheDir)
+    : _cacheDir(File::fullPath(cacheDir))
+{
+}
+
+std::string Utsi2UtmsCache::entryFilename(const std::string& key) const
+{
+    return File::joinPath(_cacheDir, key + ".utms");
+}
+
+std::string Utsi2UtmsCache::warningsFilename(const std::string& key) const
+{
+    return File::joinPath(_cacheDir, key + ".warnings");
+}
+
+std::string Utsi2UtmsCache::statFilename(const std::string& siFilename) const
+{
+    Fnv1a hash;
+    hash.add(File::fullPath(siFilename));
+
+    return File::joinPath(_cacheDir, "stat-" + hash.hex());
+}
+
+std::string Utsi2UtmsCache::lookupKey(const std::string& siFilename) const
+{
+    std::ifstream in(statFilename(siFilename));
+    if (!in) {
+        return std::string();
+    }
+
+    unsigned version = 0;
+    std::string key, imageFilename;
+    FileStat siStat, imageStat;
+
+    in >> version >> key >> siStat >> std::ws;
+    std::getline(in, imageFilename);
+    in >> imageStat;
+
+    if (in.fail() || version != CACHE_VERSION || key.empty()) {
+        return std::string();
+    }
+
+    if (siStat == FileStat::fromFile(siFilename)
+        && imageStat == FileStat::fromFile(imageFilename)) {
+
+        return key;
+    }
+    else {
+        return std::string();
+    }
+}
+
+std::string Utsi2UtmsCache::calculateKey(const SI::FrameSet& frameSet,
+                                         const std::string& siFilename) const
+{
+    const std::string& imageFilename = frameSet.imageFilename();
+
+    // stat before reading, a file modified while hashing will be
+    // detected on the next lookup.
+    const FileStat siStat = FileStat::fromFile(siFilename);
+    const FileStat imageStat = FileStat::fromFile(imageFilename);
+
+    Fnv1a siHash;
+    {
+        std::stringstream xml;
+        SI::Serializer::writeFile(frameSet, xml);
+
+        const unsigned version = CACHE_VERSION;
+        siHash.add(&version, sizeof(version));
+        siHash.add(xml.str());
+    }
+
+    Fnv1a imageHash;
+    if (!imageFilename.empty()) {
+        std::string imageData;
+
+        if (!readBinaryFile(imageFilename, imageData)) {
+            throw std::runtime_error(imageFilename + ": Cannot read image");
+        }
+        imageHash.add(imageData);
+    }
+
+    std::string key = siHash.hex() + imageHash.hex();
+
+    {
+        AtomicOfStream out(statFilename(siFilename));
+
+        out << CACHE_VERSION << '\n'
+            << key << '\n'
+            << siStat << '\n'
+            << imageFilename << '\n'
+            << imageStat << '\n';
+
+        out.commit();
+    }
+
+    return key;
+}
+
+bool Utsi2UtmsCache::fetch(const std::string& key, std::string& msXml,
+                           std::list<std::string>& warnings) const
+{
+    // The warnings are stored first, an entry without them is incomplete
+    std::ifstream in(warningsFilename(key), std::ios::in | std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    std::list<std::string> w;
+    std::string line;
+    while (std::getline(in, line)) {
+        w.emplace_back();
+        if (!unescapeLine(line, w.back())) {
+            return false;
+        }
+    }
+
+    if (!readBinaryFile(entryFilename(key), msXml)) {
+        return false;
+    }
+
+    warnings = std::move(w);
+    return true;
+}
+
+void Utsi2UtmsCache::store(const std::string& key, const std::string& msXml,
+                           const std::list<std::string>& warnings) const
+{
+    {
+        // one escaped warning per line
+        AtomicOfStream out(warningsFilename(key), std::ios_base::out | std::ios_base::binary);
+
+        for (const std::string& w : warnings) {
+            out << escapeLine(w) << '\n';
+        }
+        out.commit();
+    }
+
+    {
+        AtomicOfStream out(entryFilename(key), std::ios_base::out | std::ios_base::binary);
+        out << msXml;
+        out.commit();
+    }
+}
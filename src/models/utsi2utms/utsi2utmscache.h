@@ -0,0 +1,76 @@
+#ifndef _UNTECH_MODELS_UTSI2UTMS_UTSI2UTMSCACHE_H
+#define _UNTECH_MODELS_UTSI2UTMS_UTSI2UTMSCACHE_H
+
+#include "models/sprite-importer/frameset.h"
+#include <list>
+#include <string>
+
+namespace UnTech {
+
+/**
+ * An on-disk cache of Utsi2Utms conversions.
+ *
+ * Entries are keyed by a hash of the serialized SpriteImporter frameset
+ * and the bytes of its image file and contain the MetaSprite XML output
+ * and the warnings of the conversion.
+ *
+ * To skip the hashing of unchanged files the cache also remembers the
+ * size/mtime of the last processed .utsi and image files.
+ *
+ * Only successful conversions are cached.
+ *
+ * The cache directory must exist.
+ *
+ * THREADS: Different input files may be processed in parallel.
+ */
+class Utsi2UtmsCache {
+public:
+    /** Changing this value invalidates all existing cache entries */
+    const static unsigned CACHE_VERSION = 6;
+
+public:
+    Utsi2UtmsCache() = delete;
+    Utsi2UtmsCache(const Utsi2UtmsCache&) = delete;
+
+    explicit Utsi2UtmsCache(const std::string& cacheDir);
+
+    /**
+     * Returns the key of the last calculation of siFilename if neither
+     * the .utsi file or its image have changed since.
+     *
+     * Returns an empty string if the key needs to be recalculated.
+     */
+    std::string lookupKey(const std::string& siFilename) const;
+
+    /**
+     * Calculates the cache key of the frameset (which was loaded from
+     * siFilename) and records the file stats for `lookupKey`.
+     *
+     * Raises an exception if the image cannot be read.
+     */
+    std::string calculateKey(const SpriteImporter::FrameSet& frameSet,
+                             const std::string& siFilename) const;
+
+    /**
+     * Retrieves the cached MetaSprite XML and conversion warnings for
+     * the given key.
+     *
+     * Returns false if there is no cache entry.
+     */
+    bool fetch(const std::string& key, std::string& msXml,
+               std::list<std::string>& warnings) const;
+
+    /** Stores the serialized MetaSprite frameset and its warnings in the cache */
+    void store(const std::string& key, const std::string& msXml,
+               const std::list<std::string>& warnings) const;
+
+private:
+    std::string entryFilename(const std::string& key) const;
+    std::string warningsFilename(const std::string& key) const;
+    std::string statFilename(const std::string& siFilename) const;
+
+private:
+    const std::string _cacheDir;
+};
+}
+#endif
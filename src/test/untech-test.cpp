@@ -0,0 +1,981 @@
+#include "../models/sprite-importer.h"
+#include "../models/sprite-importer/frameobjectcover.h"
+#include "../models/metasprite.h"
+#include "../models/metasprite/binaryformat.h"
+#include "../models/metasprite/tilesetorder.h"
+#include "../models/utsi2utms/utsi2utms.h"
+#include "../models/utsi2utms/utsi2utmscache.h"
+#include "../models/utsi2utms/sharedtilepool.h"
+#include "../models/common/base64.h"
+#include "../models/common/file.h"
+#include "../models/common/image.h"
+#include "../models/snes/bitplanes.h"
+#include "../models/snes/snescolor.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace UnTech;
+
+namespace SI = UnTech::SpriteImporter;
+namespace MS = UnTech::MetaSprite;
+
+/*
+ * TEST RUNNER
+ * ===========
+ */
+
+class TestRunner {
+public:
+    TestRunner() = default;
+
+    void run(const std::string& name, const std::function<void()>& func)
+    {
+        try {
+            func();
+            std::cout << "PASS\t" << name << '\n';
+        }
+        catch (const std::exception& ex) {
+            std::cout << "FAIL\t" << name << ": " << ex.what() << '\n';
+            _nFailures++;
+        }
+    }
+
+    unsigned nFailures() const { return _nFailures; }
+
+private:
+    unsigned _nFailures = 0;
+};
+
+inline void check(bool condition, const std::string& message)
+{
+    if (!condition) {
+        throw std::runtime_error(message);
+    }
+}
+
+/*
+ * SYNTHETIC FRAMESETS
+ * ===================
+ */
+
+const rgba TRANSPARENT_COLOR(0, 0, 0, 0xFF);
+
+// Creates a frameset with a single frame covering the whole image.
+SI::Frame& createFrame(SI::SpriteImporterDocument& document, const usize& size)
+{
+    SI::FrameSet& frameSet = document.frameSet();
+
+    frameSet.setTransparentColor(TRANSPARENT_COLOR);
+
+    Image image(size);
+    for (unsigned y = 0; y < size.height; y++) {
+        rgba* imgBits = image.scanline(y);
+        for (unsigned x = 0; x < size.width; x++) {
+            imgBits[x] = TRANSPARENT_COLOR;
+        }
+    }
+    frameSet.image() = std::move(image);
+
+    SI::Frame* frame = frameSet.frames().create("frame");
+    frame->setUseGridLocation(false);
+    frame->setLocation(urect(0, 0, size.width, size.height));
+
+    return *frame;
+}
+
+// Fills an area of the frameset image with opaque pixels.
+// If `unique` is set then no two 8x8 tiles in the area are identical.
+void fillArea(SI::FrameSet& frameSet, const urect& area, bool unique)
+{
+    Image& image = frameSet.image();
+
+    for (unsigned y = 0; y < area.height; y++) {
+        rgba* imgBits = image.scanline(area.y + y) + area.x;
+
+        for (unsigned x = 0; x < area.width; x++) {
+            if (unique) {
+                imgBits[x] = rgba(x, y, 0x80, 0xFF);
+            }
+            else {
+                imgBits[x] = rgba((x * 7 + y * 3) & 0xFF, 0xC0, 0x40, 0xFF);
+            }
+        }
+    }
+}
+
+/*
+ * TESTS
+ * =====
+ */
+
+// The random data of the implementation tests is the same on every run
+std::vector<uint8_t> randomBytes(size_t size, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<unsigned> dist(0, 255);
+
+    std::vector<uint8_t> ret(size);
+    for (auto& b : ret) {
+        b = dist(rng);
+    }
+    return ret;
+}
+
+// Each implementation converts random tiles the same as the scalar
+// implementation and writeTiles reverses readTiles.
+void testBitplanes(unsigned impl, unsigned bitDepth, size_t count)
+{
+    namespace BP = Snes::Bitplanes;
+
+    const size_t planarSize = count * bitDepth * 8;
+    const size_t tilesSize = count * 64;
+
+    const std::vector<uint8_t> planar = randomBytes(planarSize, bitDepth * 1000 + count);
+
+    std::vector<uint8_t> expectedTiles(tilesSize);
+    std::vector<uint8_t> tiles(tilesSize);
+    BP::readTilesWith(0, bitDepth, planar.data(), expectedTiles.data(), count);
+    BP::readTilesWith(impl, bitDepth, planar.data(), tiles.data(), count);
+
+    check(tiles == expectedTiles, "readTiles differs from scalar");
+
+    std::vector<uint8_t> written(planarSize);
+    BP::writeTilesWith(impl, bitDepth, tiles.data(), written.data(), count);
+
+    check(written == planar, "writeTiles did not reverse readTiles");
+
+    // pixels in range for the bit depth
+    std::vector<uint8_t> chunky = randomBytes(tilesSize, bitDepth * 2000 + count);
+    for (auto& p : chunky) {
+        p &= (1 << bitDepth) - 1;
+    }
+
+    std::vector<uint8_t> expectedPlanar(planarSize);
+    BP::writeTilesWith(0, bitDepth, chunky.data(), expectedPlanar.data(), count);
+    BP::writeTilesWith(impl, bitDepth, chunky.data(), written.data(), count);
+
+    check(written == expectedPlanar, "writeTiles differs from scalar");
+}
+
+void testBitplanes(TestRunner& runner)
+{
+    namespace BP = Snes::Bitplanes;
+
+    for (unsigned impl = 0; impl < BP::nImplementations(); impl++) {
+        for (unsigned bitDepth : { 2, 4, 6, 8 }) {
+            const std::string name = std::string("bitplanes/") + BP::implementationName(impl)
+                                     + "/" + std::to_string(bitDepth) + "bpp";
+
+            runner.run(name, [=]() {
+                for (size_t count : { 0, 1, 2, 3, 4, 7, 8, 9, 31, 64 }) {
+                    testBitplanes(impl, bitDepth, count);
+                }
+            });
+        }
+    }
+}
+
+std::string base64Encode(unsigned impl, const std::vector<uint8_t>& data, unsigned indent)
+{
+    std::stringstream out;
+    Base64::encodeWith(impl, data, out, indent);
+    return out.str();
+}
+
+// The SIMD encoder is used for lines with at least 52 bytes remaining,
+// the lengths around every line (and write block) boundary are tested.
+void testBase64Encode(unsigned impl)
+{
+    const size_t BYTES_PER_LINE = 48;
+
+    std::vector<size_t> sizes;
+    for (size_t s = 0; s <= BYTES_PER_LINE * 3 + 8; s++) {
+        sizes.push_back(s);
+    }
+    for (size_t s = BYTES_PER_LINE * 64 - 8; s <= BYTES_PER_LINE * 64 + 8; s++) {
+        sizes.push_back(s);
+    }
+
+    for (size_t size : sizes) {
+        const std::vector<uint8_t> data = randomBytes(size, size);
+
+        for (unsigned indent : { 0, 4 }) {
+            const std::string text = base64Encode(impl, data, indent);
+
+            check(text == base64Encode(0, data, indent),
+                  std::to_string(size) + " bytes: encoding differs from scalar");
+
+            check(Base64::decodeWith(impl, text) == data,
+                  std::to_string(size) + " bytes: decode does not reverse encode");
+        }
+    }
+}
+
+// The SIMD decoders process blocks of 32 or 64 valid characters, stopping
+// at whitespace and padding. The lengths around the block sizes are
+// tested with and without invalid characters in the text.
+void testBase64Decode(unsigned impl)
+{
+    const std::string chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/-_";
+    const std::string invalid = " \n\r\t=.*";
+
+    for (size_t size = 0; size <= 200; size++) {
+        const std::vector<uint8_t> r = randomBytes(size + 16, size + 10000);
+
+        for (unsigned nInvalid : { 0, 1, 3, 9 }) {
+            std::string text;
+            for (size_t i = 0; i < size; i++) {
+                text += chars[r[i] % chars.size()];
+            }
+
+            for (unsigned i = 0; i < nInvalid && size > 0; i++) {
+                const size_t pos = r[size + i] * text.size() / 256;
+                text.insert(text.begin() + pos, invalid[r[size + i + 1] % invalid.size()]);
+            }
+
+            const std::vector<uint8_t> expected = Base64::decodeWith(0, text);
+
+            check(Base64::decodeWith(impl, text) == expected,
+                  std::to_string(size) + " chars, " + std::to_string(nInvalid)
+                      + " invalid: decoding differs from scalar");
+        }
+    }
+
+    // padding and whitespace in the middle of MIME encoded text
+    const std::vector<uint8_t> data = randomBytes(200, 42);
+    for (size_t split = 0; split <= data.size(); split += 7) {
+        const std::vector<uint8_t> a(data.begin(), data.begin() + split);
+        const std::vector<uint8_t> b(data.begin() + split, data.end());
+
+        const std::string text = base64Encode(0, a, 2) + "\n  " + base64Encode(0, b, 2);
+
+        check(Base64::decodeWith(impl, text) == Base64::decodeWith(0, text),
+              "split at " + std::to_string(split) + ": decoding differs from scalar");
+    }
+}
+
+// The streaming decoder returns the same data regardless of where
+// the text is split.
+void testBase64Decoder()
+{
+    const std::vector<uint8_t> data = randomBytes(300, 7);
+
+    std::stringstream out;
+    Base64::encode(data, out, 4);
+    const std::string text = out.str();
+
+    for (size_t split = 0; split <= text.size(); split++) {
+        std::vector<uint8_t> decoded(Base64::Decoder::maxDecodedSize(text.size()) + 1);
+
+        Base64::Decoder decoder;
+        size_t size = decoder.decode(text.data(), split, decoded.data());
+        size += decoder.decode(text.data() + split, text.size() - split, decoded.data() + size);
+        decoded.resize(size);
+
+        check(decoded == data, "split at " + std::to_string(split) + ": decoded data differs");
+    }
+}
+
+void testBase64(TestRunner& runner)
+{
+    for (unsigned impl = 0; impl < Base64::nImplementations(); impl++) {
+        const std::string name = std::string("base64/") + Base64::implementationName(impl);
+
+        runner.run(name + "/encode", [=]() { testBase64Encode(impl); });
+        runner.run(name + "/decode", [=]() { testBase64Decode(impl); });
+    }
+
+    runner.run("base64/decoder", testBase64Decoder);
+}
+
+// A solid N*16 pixel square is covered by N*N large objects
+void testFrameObjectCoverSquare(unsigned n, unsigned offset, bool unique)
+{
+    const unsigned size = n * 16;
+
+    SI::SpriteImporterDocument document;
+    SI::Frame& frame = createFrame(document, usize(size + offset * 2, size + offset * 2));
+    fillArea(document.frameSet(), urect(offset, offset, size, size), unique);
+
+    SI::FrameObjectCover cover;
+    const auto objects = cover.process(frame);
+
+    check(objects.size() == n * n,
+          std::to_string(objects.size()) + " objects, expected " + std::to_string(n * n));
+
+    for (const auto& obj : objects) {
+        check(obj.size == SI::FrameObject::ObjectSize::LARGE, "small object in cover");
+    }
+}
+
+void testFrameObjectCover(TestRunner& runner)
+{
+    for (unsigned n = 1; n <= 8; n++) {
+        for (unsigned offset : { 0, 5 }) {
+            for (bool unique : { false, true }) {
+                const std::string name = "frameobjectcover/square/" + std::to_string(n * 16)
+                                         + "/offset-" + std::to_string(offset)
+                                         + (unique ? "/unique" : "/pattern");
+
+                runner.run(name, [=]() { testFrameObjectCoverSquare(n, offset, unique); });
+            }
+        }
+    }
+}
+
+// A stack of overlapping objects, each drawn over the objects after it,
+// is converted into a MetaSprite frame that draws the same pixels.
+void testUtsi2UtmsOverlap(unsigned nObjects, unsigned seed)
+{
+    const unsigned FRAME_SIZE = 48;
+    const unsigned N_COLORS = 8;
+    const upoint origin(FRAME_SIZE / 2, FRAME_SIZE / 2);
+
+    SI::SpriteImporterDocument document;
+    SI::FrameSet& frameSet = document.frameSet();
+    SI::Frame& frame = createFrame(document, usize(FRAME_SIZE, FRAME_SIZE));
+
+    frame.setUseGridOrigin(false);
+    frame.setOrigin(origin);
+
+    std::vector<urect> objects;
+    for (unsigned i = 0; i < nObjects; i++) {
+        const auto size = ((i + seed) % 2 == 0) ? SI::FrameObject::ObjectSize::LARGE
+                                                : SI::FrameObject::ObjectSize::SMALL;
+        const upoint location(4 + i * 3, 4 + i * 2 + seed % 3);
+
+        SI::FrameObject& obj = frame.objects().create();
+        obj.setSize(size);
+        obj.setLocation(location);
+
+        objects.emplace_back(location.x, location.y, obj.sizePx(), obj.sizePx());
+    }
+
+    // The first object is on top, paint back to front
+    Image& image = frameSet.image();
+    for (unsigned i = nObjects; i-- > 0;) {
+        const urect& r = objects[i];
+
+        for (unsigned y = r.top(); y < r.bottom(); y++) {
+            for (unsigned x = r.left(); x < r.right(); x++) {
+                const unsigned c = (x * 5 + y * 3 + i * 7 + seed) % (N_COLORS + 1);
+
+                if (c != 0) {
+                    image.scanline(y)[x] = rgba(c * 24, 0x80, 0xF8 - c * 16, 0xFF);
+                }
+            }
+        }
+    }
+
+    UnTech::Utsi2Utms converter;
+    converter.setThreadCount(1);
+    std::unique_ptr<MS::MetaSpriteDocument> msDocument = converter.convert(document);
+
+    if (msDocument == nullptr || !converter.errors().empty()) {
+        const std::string error = converter.errors().empty() ? "" : converter.errors().front();
+        throw std::runtime_error("conversion failed: " + error);
+    }
+
+    const MS::FrameSet& msFrameSet = msDocument->frameSet();
+    const MS::Frame& msFrame = msFrameSet.frames().at("frame");
+
+    Image rendered(FRAME_SIZE, FRAME_SIZE);
+    rendered.fill(TRANSPARENT_COLOR);
+    msFrame.draw(rendered, msFrameSet.palettes().at(0), origin.x, origin.y);
+
+    unsigned nMismatches = 0;
+    for (unsigned y = 0; y < FRAME_SIZE; y++) {
+        for (unsigned x = 0; x < FRAME_SIZE; x++) {
+            const rgba& p = image.scanline(y)[x];
+            const rgba expected = p == TRANSPARENT_COLOR ? p : Snes::SnesColor(p).rgb();
+
+            if (rendered.scanline(y)[x] != expected) {
+                nMismatches++;
+            }
+        }
+    }
+
+    check(nMismatches == 0, std::to_string(nMismatches) + " mismatched pixels");
+}
+
+void testUtsi2UtmsOverlap(TestRunner& runner)
+{
+    for (unsigned n = 2; n <= 6; n++) {
+        for (unsigned seed = 0; seed < 4; seed++) {
+            const std::string name = "utsi2utms/overlap/" + std::to_string(n) + "-objects/"
+                                     + std::to_string(seed);
+
+            runner.run(name, [=]() { testUtsi2UtmsOverlap(n, seed); });
+        }
+    }
+}
+
+// A cache hit returns the same MetaSprite XML and warnings as the
+// conversion that stored it.
+void testUtsi2UtmsCacheHit(const std::string& cacheDir, const std::list<std::string>& extraWarnings)
+{
+    SI::SpriteImporterDocument document;
+    SI::Frame& frame = createFrame(document, usize(16, 16));
+
+    // No transparent pixels in the object, warns about the transparent color
+    Image& image = document.frameSet().image();
+    for (unsigned y = 0; y < 16; y++) {
+        for (unsigned x = 0; x < 16; x++) {
+            image.scanline(y)[x] = rgba((x + y) % 4 * 0x40, 0x80, 0x40, 0xFF);
+        }
+    }
+    frame.objects().create().setSize(SI::FrameObject::ObjectSize::LARGE);
+
+    UnTech::Utsi2Utms converter;
+    converter.setThreadCount(1);
+    std::unique_ptr<MS::MetaSpriteDocument> msDocument = converter.convert(document);
+
+    check(msDocument != nullptr && converter.errors().empty(), "conversion failed");
+    check(!converter.warnings().empty(), "expected a conversion warning");
+
+    std::list<std::string> warnings = converter.warnings();
+    warnings.insert(warnings.end(), extraWarnings.begin(), extraWarnings.end());
+
+    std::stringstream out;
+    MS::Serializer::writeFile(msDocument->frameSet(), out);
+    const std::string msXml = out.str();
+
+    Utsi2UtmsCache cache(cacheDir);
+    const std::string siFilename = File::joinPath(cacheDir, "missing.utsi");
+    const std::string key = cache.calculateKey(document.frameSet(), siFilename);
+
+    std::string cachedXml;
+    std::list<std::string> cachedWarnings;
+
+    check(!cache.fetch(key + "-unknown", cachedXml, cachedWarnings), "hit on an unknown key");
+
+    cache.store(key, msXml, warnings);
+
+    check(cache.fetch(key, cachedXml, cachedWarnings), "no cache entry after store");
+    check(cachedXml == msXml, "cached MetaSprite XML differs");
+    check(cachedWarnings == warnings, "cached warnings differ");
+}
+
+void testUtsi2UtmsCache(TestRunner& runner, const std::string& cacheDir)
+{
+    const std::list<std::list<std::string>> extraWarnings = {
+        {},
+        { "" },
+        { "multi\nline\nwarning", "trailing newline\n" },
+        { "back\\slash \\n", "\\", "carriage\r\nreturn" },
+    };
+
+    unsigned i = 0;
+    for (const auto& w : extraWarnings) {
+        const std::string name = "utsi2utmscache/hit/" + std::to_string(i++);
+
+        runner.run(name, [&]() { testUtsi2UtmsCacheHit(cacheDir, w); });
+    }
+}
+
+// Draws every frame of the frameset, side by side.
+Image drawFrames(const MS::FrameSet& frameSet)
+{
+    const unsigned FRAME_SIZE = 64;
+
+    Image image(FRAME_SIZE * frameSet.frames().size(), FRAME_SIZE);
+    image.fill(rgba(0, 0, 0, 0));
+
+    unsigned x = 0;
+    for (const auto fIt : frameSet.frames()) {
+        fIt.second.draw(image, frameSet.palettes().at(0), x + FRAME_SIZE / 2, FRAME_SIZE / 2);
+        x += FRAME_SIZE;
+    }
+
+    return image;
+}
+
+void checkTileIds(const MS::FrameSet& frameSet)
+{
+    for (const auto fIt : frameSet.frames()) {
+        for (const MS::FrameObject& obj : fIt.second.objects()) {
+            const size_t nTiles = obj.size() == MS::FrameObject::ObjectSize::LARGE
+                                      ? frameSet.largeTileset().size()
+                                      : frameSet.smallTileset().size();
+
+            check(obj.tileId() < nTiles, "tileId out of range in " + fIt.first);
+        }
+    }
+}
+
+const unsigned N_RANDOM_SMALL_TILES = 40;
+const unsigned N_RANDOM_LARGE_TILES = 20;
+
+// Creates a frameset with random tiles (from tileSeed) and frames with
+// scattered tile ids (from frameSeed).
+void createRandomFrameSet(MS::FrameSet& frameSet, unsigned tileSeed, unsigned frameSeed)
+{
+    std::mt19937 rng(tileSeed);
+    auto random = [&](unsigned n) { return unsigned(rng() % n); };
+
+    MS::Palette& palette = frameSet.palettes().create();
+    for (unsigned c = 1; c < 16; c++) {
+        palette.color(c).setRgb(rgba(c * 16, 0xFF - c * 16, c * 8, 0xFF));
+    }
+
+    for (unsigned t = 0; t < N_RANDOM_SMALL_TILES; t++) {
+        frameSet.smallTileset().addTile();
+        for (auto& p : frameSet.smallTileset().tile(t)) {
+            p = random(16);
+        }
+    }
+    for (unsigned t = 0; t < N_RANDOM_LARGE_TILES; t++) {
+        frameSet.largeTileset().addTile();
+        for (auto& p : frameSet.largeTileset().tile(t)) {
+            p = random(16);
+        }
+    }
+
+    rng.seed(frameSeed);
+
+    for (unsigned f = 0; f < 12; f++) {
+        MS::Frame* frame = frameSet.frames().create("frame" + std::to_string(f));
+
+        const unsigned nObjects = 1 + random(6);
+        for (unsigned i = 0; i < nObjects; i++) {
+            MS::FrameObject& obj = frame->objects().create();
+
+            const bool large = random(2);
+            obj.setSize(large ? MS::FrameObject::ObjectSize::LARGE : MS::FrameObject::ObjectSize::SMALL);
+            obj.setTileId(random(large ? N_RANDOM_LARGE_TILES : N_RANDOM_SMALL_TILES));
+            obj.setLocation(ms8point(int(random(48)) - 32, int(random(48)) - 32));
+            obj.setOrder(random(4));
+            obj.setHFlip(random(2));
+            obj.setVFlip(random(2));
+        }
+    }
+}
+
+// Reordering a frameset with random tiles and scattered tile ids
+// keeps the tile ids valid and draws the same frames.
+void testTilesetOrder(unsigned seed)
+{
+    MS::MetaSpriteDocument document;
+    MS::FrameSet& frameSet = document.frameSet();
+
+    createRandomFrameSet(frameSet, seed, seed);
+
+    const Image expected = drawFrames(frameSet);
+    unsigned nTransfers = 0;
+    for (const auto fIt : frameSet.frames()) {
+        nTransfers += MS::frameDmaUsage(fIt.second).nTransfers;
+    }
+
+    MS::optimizeTilesetOrder(frameSet);
+
+    check(frameSet.smallTileset().size() == N_RANDOM_SMALL_TILES, "small tileset size changed");
+    check(frameSet.largeTileset().size() == N_RANDOM_LARGE_TILES, "large tileset size changed");
+    checkTileIds(frameSet);
+
+    const Image reordered = drawFrames(frameSet);
+    for (unsigned y = 0; y < expected.size().height; y++) {
+        const rgba* e = expected.scanline(y);
+        const rgba* r = reordered.scanline(y);
+
+        check(std::equal(e, e + expected.size().width, r), "frames differ after reordering");
+    }
+
+    unsigned nReorderedTransfers = 0;
+    for (const auto fIt : frameSet.frames()) {
+        nReorderedTransfers += MS::frameDmaUsage(fIt.second).nTransfers;
+    }
+    check(nReorderedTransfers <= nTransfers, "reordering increased the DMA transfers");
+}
+
+void testTilesetOrder(TestRunner& runner)
+{
+    for (unsigned seed = 0; seed < 8; seed++) {
+        runner.run("tilesetorder/random/" + std::to_string(seed), [=]() { testTilesetOrder(seed); });
+    }
+}
+
+// Converts a synthetic frameset with every kind of frame data.
+std::unique_ptr<MS::MetaSpriteDocument> createMsDocument()
+{
+    const unsigned FRAME_SIZE = 32;
+
+    SI::SpriteImporterDocument document;
+    SI::FrameSet& frameSet = document.frameSet();
+    frameSet.setName("test");
+
+    SI::Frame& frame = createFrame(document, usize(FRAME_SIZE, FRAME_SIZE));
+
+    Image& image = frameSet.image();
+    for (unsigned y = 0; y < 24; y++) {
+        for (unsigned x = 0; x < 24; x++) {
+            image.scanline(y)[x] = rgba((x + y) % 4 * 0x40, 0x80, 0x40 + y % 3 * 0x20, 0xFF);
+        }
+    }
+    image.scanline(20)[20] = TRANSPARENT_COLOR;
+
+    frame.objects().create().setSize(SI::FrameObject::ObjectSize::LARGE);
+    for (unsigned i = 0; i < 3; i++) {
+        SI::FrameObject& obj = frame.objects().create();
+        obj.setSize(SI::FrameObject::ObjectSize::SMALL);
+        obj.setLocation(upoint(16, i * 8));
+    }
+    frame.setUseGridOrigin(false);
+    frame.setOrigin(upoint(12, 12));
+
+    UnTech::Utsi2Utms converter;
+    converter.setThreadCount(1);
+    std::unique_ptr<MS::MetaSpriteDocument> msDocument = converter.convert(document);
+
+    check(msDocument != nullptr && converter.errors().empty(), "conversion failed");
+
+    MS::FrameSet& msFrameSet = msDocument->frameSet();
+
+    // a second frame, with hitboxes, action points and flipped objects
+    MS::Frame* msFrame = msFrameSet.frames().clone(msFrameSet.frames().at("frame"), "another");
+    check(msFrame != nullptr, "cannot clone frame");
+
+    for (MS::FrameObject& obj : msFrame->objects()) {
+        obj.setHFlip(true);
+        obj.setOrder(2);
+    }
+
+    MS::ActionPoint& ap = msFrame->actionPoints().create();
+    ap.setLocation(ms8point(-5, 7));
+    ap.setParameter(42);
+
+    MS::EntityHitbox& eh = msFrame->entityHitboxes().create();
+    eh.setAabb(ms8rect(-8, -4, 16, 12));
+    eh.setParameter(3);
+
+    msFrame->setSolid(true);
+    msFrame->setTileHitbox(ms8rect(-6, -6, 12, 12));
+
+    return msDocument;
+}
+
+std::string msXml(const MS::FrameSet& frameSet)
+{
+    std::stringstream out;
+    MS::Serializer::writeFile(frameSet, out);
+    return out.str();
+}
+
+template <class TileT>
+void flipTile(TileT& tile, unsigned size, bool hFlip, bool vFlip)
+{
+    const TileT original = tile;
+
+    for (unsigned y = 0; y < size; y++) {
+        for (unsigned x = 0; x < size; x++) {
+            const unsigned fx = hFlip ? size - 1 - x : x;
+            const unsigned fy = vFlip ? size - 1 - y : y;
+
+            tile[y * size + x] = original[fy * size + fx];
+        }
+    }
+}
+
+// Framesets with reversed and flipped copies of the same tiles share the
+// pool tiles. Drawing the frames with the pool and the tile map gives
+// the same pixels as the framesets' own tiles.
+void testSharedTilePool(unsigned nFrameSets)
+{
+    SharedTilePool pool;
+    std::vector<std::unique_ptr<MS::MetaSpriteDocument>> documents;
+    std::vector<std::string> xmls;
+
+    for (unsigned i = 0; i < nFrameSets; i++) {
+        documents.push_back(std::make_unique<MS::MetaSpriteDocument>());
+        MS::FrameSet& frameSet = documents.back()->frameSet();
+
+        createRandomFrameSet(frameSet, 0, i + 100);
+
+        if (i % 2 == 1) {
+            auto& small = frameSet.smallTileset();
+            auto& large = frameSet.largeTileset();
+
+            for (unsigned t = 0; t < small.size(); t++) {
+                flipTile(small.tile(t), 8, (t + i) % 3 == 1, (t + i) % 3 == 2);
+            }
+            for (unsigned t = 0; t < large.size(); t++) {
+                flipTile(large.tile(t), 16, (t + i) % 3 == 1, (t + i) % 3 == 2);
+            }
+            for (unsigned t = 0; t < small.size() / 2; t++) {
+                std::swap(small.tile(t), small.tile(small.size() - 1 - t));
+            }
+            for (unsigned t = 0; t < large.size() / 2; t++) {
+                std::swap(large.tile(t), large.tile(large.size() - 1 - t));
+            }
+        }
+
+        xmls.push_back(msXml(frameSet));
+
+        pool.addFrameSet(frameSet);
+    }
+
+    check(pool.smallTileset().size() <= N_RANDOM_SMALL_TILES, "duplicate small tiles in pool");
+    check(pool.largeTileset().size() <= N_RANDOM_LARGE_TILES, "duplicate large tiles in pool");
+    check(pool.tileMaps().size() == nFrameSets, "missing tile maps");
+
+    for (unsigned i = 0; i < nFrameSets; i++) {
+        MS::FrameSet& frameSet = documents.at(i)->frameSet();
+        const SharedTilePool::TileMap& tileMap = pool.tileMaps().at(i);
+
+        check(msXml(frameSet) == xmls.at(i), "frameset modified by the pool");
+
+        const Image expected = drawFrames(frameSet);
+
+        for (const auto fIt : frameSet.frames()) {
+            for (MS::FrameObject& obj : fIt.second.objects()) {
+                const bool large = obj.size() == MS::FrameObject::ObjectSize::LARGE;
+                const auto& pt = large ? tileMap.largeTiles.at(obj.tileId())
+                                       : tileMap.smallTiles.at(obj.tileId());
+
+                check(pt.used, "used tile not in the tile map");
+
+                obj.setTileId(pt.tileId);
+                obj.setHFlip(obj.hFlip() != pt.hFlip);
+                obj.setVFlip(obj.vFlip() != pt.vFlip);
+            }
+        }
+        frameSet.smallTileset() = pool.smallTileset();
+        frameSet.largeTileset() = pool.largeTileset();
+
+        checkTileIds(frameSet);
+
+        const Image pooled = drawFrames(frameSet);
+        for (unsigned y = 0; y < expected.size().height; y++) {
+            const rgba* e = expected.scanline(y);
+            const rgba* p = pooled.scanline(y);
+
+            check(std::equal(e, e + expected.size().width, p), "frames differ with the pool tiles");
+        }
+    }
+}
+
+void testSharedTilePool(TestRunner& runner)
+{
+    for (unsigned n : { 1, 2, 5 }) {
+        runner.run("sharedtilepool/" + std::to_string(n) + "-framesets", [=]() { testSharedTilePool(n); });
+    }
+}
+
+std::vector<uint8_t> readBytes(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeBytes(const std::string& filename, const std::vector<uint8_t>& data)
+{
+    std::ofstream out(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    check(out.good(), "cannot write " + filename);
+}
+
+// XML -> utmb -> XML returns the same XML
+void testBinaryFormatRoundTrip(const std::string& tmpDir)
+{
+    const std::string xmlFilename = File::joinPath(tmpDir, "roundtrip.utms");
+    const std::string binFilename = File::joinPath(tmpDir, "roundtrip.utmb");
+
+    createMsDocument()->writeDataFile(xmlFilename);
+
+    MS::MetaSpriteDocument xmlDocument(xmlFilename);
+    const std::string xml = msXml(xmlDocument.frameSet());
+
+    check(xmlDocument.frameSet().frames().size() == 2, "expected 2 frames");
+    check(xmlDocument.frameSet().smallTileset().size() > 0, "expected small tiles");
+    check(xmlDocument.frameSet().largeTileset().size() > 0, "expected large tiles");
+
+    xmlDocument.writeDataFile(binFilename);
+
+    MS::MetaSpriteDocument binDocument(binFilename);
+
+    check(msXml(binDocument.frameSet()) == xml, "XML differs after the binary round trip");
+}
+
+// Modifies a valid utmb file, the file must not load.
+void testBinaryFormatInvalid(const std::string& tmpDir, const std::string& name,
+                             const std::function<void(std::vector<uint8_t>&)>& modify)
+{
+    const std::string validFilename = File::joinPath(tmpDir, "valid.utmb");
+    const std::string filename = File::joinPath(tmpDir, "invalid-" + name + ".utmb");
+
+    createMsDocument()->writeDataFile(validFilename);
+
+    // the unmodified file must load
+    MS::MetaSpriteDocument valid(validFilename);
+
+    std::vector<uint8_t> data = readBytes(validFilename);
+    modify(data);
+    writeBytes(filename, data);
+
+    bool loaded = true;
+    try {
+        MS::MetaSpriteDocument document(filename);
+    }
+    catch (const std::exception&) {
+        loaded = false;
+    }
+
+    check(!loaded, "invalid file loaded");
+}
+
+MS::Binary::Header& binaryHeader(std::vector<uint8_t>& data)
+{
+    return *reinterpret_cast<MS::Binary::Header*>(data.data());
+}
+
+MS::Binary::SectionEntry& binarySection(std::vector<uint8_t>& data, const char* id)
+{
+    const MS::Binary::Header& header = binaryHeader(data);
+
+    for (unsigned i = 0; i < header.nSections; i++) {
+        auto* s = reinterpret_cast<MS::Binary::SectionEntry*>(
+            data.data() + header.headerSize + i * header.sectionEntrySize);
+
+        if (memcmp(s->id, id, sizeof(s->id)) == 0) {
+            return *s;
+        }
+    }
+    throw std::runtime_error(std::string("missing section ") + id);
+}
+
+template <class T>
+T& binaryRecord(std::vector<uint8_t>& data, const char* id, unsigned index)
+{
+    const MS::Binary::SectionEntry& s = binarySection(data, id);
+    check(index < s.count, std::string("no record in section ") + id);
+
+    return reinterpret_cast<T*>(data.data() + s.offset)[index];
+}
+
+void testBinaryFormat(TestRunner& runner, const std::string& tmpDir)
+{
+    namespace MSB = MS::Binary;
+
+    typedef std::function<void(std::vector<uint8_t>&)> Modifier;
+
+    runner.run("binaryformat/roundtrip", [&]() { testBinaryFormatRoundTrip(tmpDir); });
+
+    const std::vector<std::pair<std::string, Modifier>> invalidFiles = {
+        { "empty", [](std::vector<uint8_t>& d) {
+             d.clear();
+         } },
+        { "truncated-header", [](std::vector<uint8_t>& d) {
+             d.resize(sizeof(MSB::Header) - 1);
+         } },
+        { "truncated", [](std::vector<uint8_t>& d) {
+             d.resize(d.size() - MSB::SECTION_ALIGNMENT);
+         } },
+        { "truncated-filesize", [](std::vector<uint8_t>& d) {
+             // the last section is now out of range
+             d.resize(d.size() - MSB::SECTION_ALIGNMENT);
+             binaryHeader(d).fileSize = d.size();
+         } },
+        { "truncated-section-table", [](std::vector<uint8_t>& d) {
+             d.resize(sizeof(MSB::Header) + sizeof(MSB::SectionEntry));
+             binaryHeader(d).fileSize = d.size();
+         } },
+        { "section-offset-out-of-range", [](std::vector<uint8_t>& d) {
+             binarySection(d, "OBJS").offset = d.size() + MSB::SECTION_ALIGNMENT;
+         } },
+        { "section-size-out-of-range", [](std::vector<uint8_t>& d) {
+             auto& s = binarySection(d, "OBJS");
+             s.size = d.size() - s.offset + sizeof(MSB::ObjectRecord);
+             s.count = s.size / sizeof(MSB::ObjectRecord);
+         } },
+        { "section-size-overflow", [](std::vector<uint8_t>& d) {
+             auto& s = binarySection(d, "STIL");
+             s.count = 0x8000000;
+             s.size = s.count * MSB::SMALL_TILE_SIZE;
+         } },
+        { "section-count-mismatch", [](std::vector<uint8_t>& d) {
+             binarySection(d, "FRAM").count++;
+         } },
+        { "overlapping-sections", [](std::vector<uint8_t>& d) {
+             // same size as PALT so the records are still in range
+             const auto palt = binarySection(d, "PALT");
+             auto& stil = binarySection(d, "STIL");
+             stil.offset = palt.offset;
+             stil.count = palt.size / MSB::SMALL_TILE_SIZE;
+             stil.size = stil.count * MSB::SMALL_TILE_SIZE;
+         } },
+        { "section-overlaps-table", [](std::vector<uint8_t>& d) {
+             auto& s = binarySection(d, "NAME");
+             s.offset = 0;
+         } },
+        { "name-out-of-range", [](std::vector<uint8_t>& d) {
+             binaryRecord<MSB::FrameRecord>(d, "FRAM", 0).nameOffset = binarySection(d, "NAME").size;
+         } },
+        { "objects-out-of-range", [](std::vector<uint8_t>& d) {
+             binaryRecord<MSB::FrameRecord>(d, "FRAM", 1).nObjects++;
+         } },
+        { "small-tile-id-out-of-range", [](std::vector<uint8_t>& d) {
+             const uint32_t nTiles = binarySection(d, "STIL").count;
+             for (unsigned i = 0; i < binarySection(d, "OBJS").count; i++) {
+                 auto& o = binaryRecord<MSB::ObjectRecord>(d, "OBJS", i);
+                 if (!o.large()) {
+                     o.tileId = nTiles;
+                 }
+             }
+         } },
+        { "large-tile-id-out-of-range", [](std::vector<uint8_t>& d) {
+             const uint32_t nTiles = binarySection(d, "LTIL").count;
+             for (unsigned i = 0; i < binarySection(d, "OBJS").count; i++) {
+                 auto& o = binaryRecord<MSB::ObjectRecord>(d, "OBJS", i);
+                 if (o.large()) {
+                     o.tileId = nTiles;
+                 }
+             }
+         } },
+    };
+
+    for (const auto& it : invalidFiles) {
+        const std::string& name = it.first;
+        const Modifier& modify = it.second;
+
+        runner.run("binaryformat/invalid/" + name, [&]() {
+            testBinaryFormatInvalid(tmpDir, name, modify);
+        });
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    TestRunner runner;
+
+    testBitplanes(runner);
+    testBase64(runner);
+    testFrameObjectCover(runner);
+    testUtsi2UtmsOverlap(runner);
+    testTilesetOrder(runner);
+    testSharedTilePool(runner);
+
+    // The file tests require an existing temporary directory
+    if (argc == 2) {
+        const std::string tmpDir = argv[1];
+
+        testUtsi2UtmsCache(runner, tmpDir);
+        testBinaryFormat(runner, tmpDir);
+    }
+
+    if (runner.nFailures() > 0) {
+        std::cout << runner.nFailures() << " tests failed\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}